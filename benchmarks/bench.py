@@ -0,0 +1,188 @@
+import argparse
+import json
+import os
+import platform
+import statistics
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from tapes import Tape, Changer
+from tapes.changer import LibraryInventory
+from tapes.simulator import create_tape, create_library
+
+# Runs against the file backed simulators unless real devices are given, so the
+# numbers of the bindings are the overhead of the native layer and not the drive.
+# Every result is {"name", "params", "unit", "samples", "min", "median", "mean", "p99"}.
+
+def _stats(samples):
+    ordered = sorted(samples)
+    return {
+        'samples': len(ordered),
+        'min': ordered[0],
+        'median': statistics.median(ordered),
+        'mean': statistics.fmean(ordered),
+        'p99': ordered[min(len(ordered) - 1, int(len(ordered) * 0.99))],
+    }
+
+def _result(name, params, unit, samples):
+    result = {'name': name, 'params': params, 'unit': unit}
+    result.update(_stats(samples))
+    return result
+
+def time_call(function, repeat, number):
+    # Nanoseconds per call, each sample is the mean of number calls
+    samples = []
+    for _ in range(repeat):
+        start = time.perf_counter_ns()
+        for _ in range(number):
+            function()
+        samples.append((time.perf_counter_ns() - start) / number)
+    return samples
+
+def bench_tape_bindings(tape_path, repeat, number):
+    results = []
+    with Tape(tape_path) as tape_device:
+        dev = tape_device.dev
+        calls = {
+            'query_params': dev.query_params,
+            'get_tape_position': dev.get_tape_position,
+            'read_position_long': dev.read_position_long,
+            'read_position_extended': lambda: dev.read_position(0x08),
+            'get_position': dev.get_position,
+            'query_partitions': dev.query_partitions,
+            'get_serial': dev.get_serial,
+            'get_partition_layout': tape_device.get_partition_layout,
+        }
+        for name, function in calls.items():
+            results.append(_result('tape.' + name, {}, 'ns/call', time_call(function, repeat, number)))
+    return results
+
+def bench_changer_bindings(directory, sizes, repeat, number, changer_path=None):
+    results = []
+    libraries = [(changer_path, None)] if changer_path else []
+    for size in sizes:
+        path = os.path.join(directory, 'library%d' % size)
+        # Elements are robots, drives and slots, about a tenth of the slots are full
+        drives = max(1, size // 100)
+        slots = size - drives - 1
+        barcodes = ['B%05dL9' % i for i in range(0, slots, 10)]
+        libraries.append((create_library(path, slots, ['SIM%04d' % i for i in range(drives)], barcodes=barcodes), size))
+    for device_path, size in libraries:
+        with Changer(device_path) as changer_device:
+            dev = changer_device.dev
+            packed = dev.get_inventory()
+            size = size or len(LibraryInventory(packed))
+            params = {'elements': size}
+            drive = LibraryInventory(packed).drives[0].address
+            calls = {
+                'get_inventory': dev.get_inventory,
+                'inventory_wrap': lambda: LibraryInventory(packed),
+                'inventory_barcode_map': lambda: LibraryInventory(packed).barcode_map,
+                'element_access': lambda: dev.element_access(drive),
+                'read_element_devids': dev.read_element_devids,
+            }
+            for name, function in calls.items():
+                results.append(_result('changer.' + name, params, 'ns/call', time_call(function, repeat, max(1, number * 100 // size))))
+    return results
+
+def bench_streaming(directory, block_sizes, buffer_depths, total_bytes):
+    results = []
+    for block_size in block_sizes:
+        for buffers in buffer_depths:
+            path = create_tape(os.path.join(directory, 'stream-%d-%d' % (block_size, buffers)))
+            params = {'block_size': block_size, 'buffers': buffers, 'bytes': total_bytes}
+            chunk = os.urandom(block_size)
+            with Tape(path) as tape_device:
+                start = time.perf_counter_ns()
+                with tape_device.open_writer(block_size, buffers) as writer:
+                    for _ in range(total_bytes // block_size):
+                        writer.write(chunk)
+                elapsed = time.perf_counter_ns() - start
+                results.append(_result('stream.write', params, 'MB/s', [total_bytes / elapsed * 1e3]))
+
+                tape_device.rewind()
+                buffer = bytearray(total_bytes)
+                start = time.perf_counter_ns()
+                with tape_device.open_reader(block_size, buffers) as reader:
+                    read = reader.readinto(buffer)
+                elapsed = time.perf_counter_ns() - start
+                if read != total_bytes:
+                    raise ValueError('Read back fewer bytes than written')
+                results.append(_result('stream.read', params, 'MB/s', [total_bytes / elapsed * 1e3]))
+    return results
+
+def bench_mounts(directory, iterations, move_time):
+    # Mount and swap latency with a simulated robot, move_time is the fixed cost of a move
+    path = create_library(os.path.join(directory, 'mounts'), 20, ['SIM0001'], barcodes=['M%05dL9' % i for i in range(10)],
+                          move_time=move_time)
+    params = {'move_time': move_time}
+    load, unload, swap = [], [], []
+    with Changer(path) as changer_device:
+        inv = changer_device.get_inventory()
+        drive = inv.drives[0].address
+        robot = inv.robots[0].address
+        barcodes = [element.barcode for element in inv.slots if element.is_full]
+        for i in range(iterations):
+            start = time.perf_counter_ns()
+            changer_device.load_cartridge(barcodes[i % len(barcodes)], drive, robot)
+            load.append(time.perf_counter_ns() - start)
+            start = time.perf_counter_ns()
+            changer_device.unload_cartridge(drive, robot)
+            unload.append(time.perf_counter_ns() - start)
+        changer_device.load_cartridge(barcodes[0], drive, robot)
+        for i in range(iterations):
+            start = time.perf_counter_ns()
+            changer_device.load_cartridge(barcodes[(i + 1) % len(barcodes)], drive, robot)
+            swap.append(time.perf_counter_ns() - start)
+    results = [_result('mount.load', params, 'ns', load), _result('mount.unload', params, 'ns', unload)]
+    results.append(_result('mount.swap', params, 'ns', swap))
+    return results
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmarks of the native bindings, results are printed as JSON')
+    parser.add_argument('--output', help='write the results to this file instead of stdout')
+    parser.add_argument('--repeat', type=int, default=20, help='samples of every binding')
+    parser.add_argument('--number', type=int, default=1000, help='calls averaged into one sample')
+    parser.add_argument('--sizes', type=int, nargs='+', default=[100, 1000, 10000], help='elements of the simulated libraries')
+    parser.add_argument('--block-sizes', type=int, nargs='+', default=[64*1024, 256*1024, 1024*1024])
+    parser.add_argument('--buffers', type=int, nargs='+', default=[2, 4, 8])
+    parser.add_argument('--stream-bytes', type=int, default=256*1024*1024)
+    parser.add_argument('--mounts', type=int, default=20, help='mounts and swaps measured')
+    parser.add_argument('--move-time', type=float, default=0.0)
+    parser.add_argument('--tape', help='real tape device to use for the tape bindings')
+    parser.add_argument('--changer', help='real changer device to add to the changer bindings')
+    parser.add_argument('--only', nargs='+', choices=['tape', 'changer', 'stream', 'mounts'])
+    args = parser.parse_args()
+
+    groups = args.only or ['tape', 'changer', 'stream', 'mounts']
+    results = []
+    with tempfile.TemporaryDirectory(prefix='tapes-bench-') as directory:
+        if 'tape' in groups:
+            tape_path = args.tape or create_tape(os.path.join(directory, 'bindings'))
+            results += bench_tape_bindings(tape_path, args.repeat, args.number)
+        if 'changer' in groups:
+            results += bench_changer_bindings(directory, args.sizes, args.repeat, args.number, args.changer)
+        if 'stream' in groups:
+            results += bench_streaming(directory, args.block_sizes, args.buffers, args.stream_bytes)
+        if 'mounts' in groups:
+            results += bench_mounts(directory, args.mounts, args.move_time)
+
+    report = {
+        'timestamp': time.strftime('%Y-%m-%dT%H:%M:%SZ', time.gmtime()),
+        'python': platform.python_version(),
+        'machine': platform.machine(),
+        'simulated': args.tape is None and args.changer is None,
+        'results': results,
+    }
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(report, f, indent=2)
+    else:
+        json.dump(report, sys.stdout, indent=2)
+        print()
+
+if __name__ == '__main__':
+    main()
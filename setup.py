@@ -7,7 +7,7 @@ def main():
           author="Piotr Piatyszek",
           author_email="piotr.piatyszek@pw.edu.pl",
           packages=["tapes"],
-          ext_modules=[Extension("tapes.internal.changer", ["src/changer.c"]), Extension("tapes.internal.tape", ["src/tape.c"])])
+          ext_modules=[Extension("tapes.internal.changer", ["src/changer.c", "src/inventory.c", "src/mover.c", "src/latency.c", "src/device.c", "src/simtape.c", "src/simchanger.c"]), Extension("tapes.internal.tape", ["src/tape.c", "src/stream.c", "src/results.c", "src/latency.c", "src/device.c", "src/simtape.c", "src/simchanger.c"])])
 
 if __name__ == "__main__":
     main()
@@ -1,4 +1,6 @@
+#define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <linux/version.h>
@@ -8,33 +10,101 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include "changer.h"
+#include "device.h"
+#include "latency.h"
 
 
-enum element_type {TYPE_ROBOT, TYPE_IE_STATION, TYPE_DRIVE, TYPE_SLOT};
+int changer_device_acquire(ChangerDeviceObject *self) {
+    if (self->fd < 0) {
+        PyErr_SetString(PyExc_ValueError, "Device is closed.");
+        return -1;
+    }
+    self->in_use++;
+    return self->fd;
+}
 
-void iterate_inventory(struct element_info* element_info, struct inventory* inventory, void (*callback)(struct element_status*, enum element_type type)) {
-    for (int i = 0; i<element_info->robots; i++) (*callback)(&inventory->robot_status[i], TYPE_ROBOT);
-    for (int i = 0; i<element_info->ie_stations; i++) (*callback)(&inventory->ie_status[i], TYPE_IE_STATION);
-    for (int i = 0; i<element_info->drives; i++) (*callback)(&inventory->drive_status[i], TYPE_DRIVE);
-    for (int i = 0; i<element_info->slots; i++) (*callback)(&inventory->slot_status[i], TYPE_SLOT);
+void changer_device_release(ChangerDeviceObject *self) {
+    self->in_use--;
 }
 
-void trim_barcode(struct element_status* status, enum element_type type) {
+void trim_barcode(struct element_status* status) {
     int i = 0;
     while (status->volume[i] != ' ' && status->volume[i] != '\0') i++;
     status->volume[i] = '\0';
 }
 
-static PyObject *method_move_cartridge(PyObject *self, PyObject *args) {
-    char *path;
+enum inventory_error {INVENTORY_OK, INVENTORY_ERROR_INFO, INVENTORY_ERROR_STATUS, INVENTORY_ERROR_MEMORY};
+
+/* Reads status of all elements into one packed array, called without the GIL. */
+static int read_inventory(int fd, struct element_status **elements, unsigned char **types, Py_ssize_t *count) {
+    struct element_info element_info;
+    if (dev_ioctl(fd, SMCIOC_ELEMENT_INFO, &element_info)) {
+        return INVENTORY_ERROR_INFO;
+    }
+
+    Py_ssize_t total = element_info.robots + element_info.slots + element_info.drives + element_info.ie_stations;
+    *elements = calloc(total > 0 ? total : 1, sizeof(struct element_status));
+    *types = malloc(total > 0 ? total : 1);
+    if (*elements == NULL || *types == NULL) {
+        free(*elements);
+        free(*types);
+        return INVENTORY_ERROR_MEMORY;
+    }
+
+    struct inventory inventory;
+    struct element_status *next = *elements;
+    inventory.robot_status = next;
+    next += element_info.robots;
+    inventory.slot_status = next;
+    next += element_info.slots;
+    inventory.drive_status = next;
+    next += element_info.drives;
+    inventory.ie_status = element_info.ie_stations > 0 ? next : NULL;
+
+    if (dev_ioctl(fd, SMCIOC_INVENTORY, &inventory)) {
+        free(*elements);
+        free(*types);
+        return INVENTORY_ERROR_STATUS;
+    }
+
+    unsigned char *type = *types;
+    memset(type, TYPE_ROBOT, element_info.robots);
+    type += element_info.robots;
+    memset(type, TYPE_SLOT, element_info.slots);
+    type += element_info.slots;
+    memset(type, TYPE_DRIVE, element_info.drives);
+    type += element_info.drives;
+    memset(type, TYPE_IE_STATION, element_info.ie_stations);
+    for (Py_ssize_t i = 0; i < total; i++) trim_barcode(&(*elements)[i]);
+    *count = total;
+
+    return INVENTORY_OK;
+}
+
+static PyObject *inventory_error(int error) {
+    switch (error) {
+        case INVENTORY_ERROR_INFO:
+            PyErr_SetString(PyExc_ValueError, "Failed to list available elements in the inventory.");
+            break;
+        case INVENTORY_ERROR_MEMORY:
+            PyErr_NoMemory();
+            break;
+        default:
+            PyErr_SetString(PyExc_ValueError, "Failed to execute inventory command.");
+    }
+    return NULL;
+}
+
+static PyObject *method_move_cartridge(ChangerDeviceObject *self, PyObject *args) {
     short int src, dest, robot;
-    if(!PyArg_ParseTuple(args, "sHHH", &path, &src, &dest, &robot)) {
+    if(!PyArg_ParseTuple(args, "HHH", &src, &dest, &robot)) {
         return NULL;
     }
 
-    int fd = open(path, O_RDWR);
+    int fd = changer_device_acquire(self);
     if (fd < 0) {
-        PyErr_SetString(PyExc_ValueError, "Failed to open changer ioctl device.");
         return NULL;
     }
 
@@ -44,7 +114,14 @@ static PyObject *method_move_cartridge(PyObject *self, PyObject *args) {
     move_medium.robot = robot;
     move_medium.invert = 0;
 
-    if (ioctl(fd, SMCIOC_MOVE_MEDIUM, &move_medium)) {
+    int ret;
+    uint64_t start = latency_now();
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, SMCIOC_MOVE_MEDIUM, &move_medium);
+    latency_record(LATENCY_MOVE, self->path, robot, dest, start);
+    Py_END_ALLOW_THREADS
+    changer_device_release(self);
+    if (ret) {
         PyErr_SetString(PyExc_ValueError, "Failed to move cartridge");
         return NULL;
     }
@@ -52,118 +129,481 @@ static PyObject *method_move_cartridge(PyObject *self, PyObject *args) {
     Py_RETURN_NONE;
 }
 
-static PyObject *method_get_inventory(PyObject *self, PyObject *args) {
-    char *path;
-    if(!PyArg_ParseTuple(args, "s", &path)) {
+static PyObject *method_position_robot(ChangerDeviceObject *self, PyObject *args) {
+    unsigned short dest, robot;
+    if(!PyArg_ParseTuple(args, "HH", &dest, &robot)) {
         return NULL;
     }
 
-    int fd = open(path, O_RDWR);
+    int fd = changer_device_acquire(self);
     if (fd < 0) {
-        PyErr_SetString(PyExc_ValueError, "Failed to open changer ioctl device.");
         return NULL;
     }
 
-    struct element_info element_info;
-    if (ioctl(fd, SMCIOC_ELEMENT_INFO, &element_info)) {
-        PyErr_SetString(PyExc_ValueError, "Failed to list available elements in the inventory.");
+    struct pos_to_elem pos_to_elem;
+    pos_to_elem.robot = robot;
+    pos_to_elem.destination = dest;
+    pos_to_elem.invert = 0;
+
+    int ret;
+    uint64_t start = latency_now();
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, SMCIOC_POS_TO_ELEM, &pos_to_elem);
+    latency_record(LATENCY_POSITION, self->path, robot, dest, start);
+    Py_END_ALLOW_THREADS
+    changer_device_release(self);
+    if (ret) {
+        PyErr_SetString(PyExc_ValueError, "Failed to position robot");
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *method_exchange_cartridge(ChangerDeviceObject *self, PyObject *args) {
+    unsigned short src, dest1, dest2, robot;
+    if(!PyArg_ParseTuple(args, "HHHH", &src, &dest1, &dest2, &robot)) {
+        return NULL;
+    }
+
+    int fd = changer_device_acquire(self);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct exchange_medium exchange_medium;
+    exchange_medium.source = src;
+    exchange_medium.destination1 = dest1;
+    exchange_medium.destination2 = dest2;
+    exchange_medium.robot = robot;
+    exchange_medium.invert1 = 0;
+    exchange_medium.invert2 = 0;
+
+    int ret, error;
+    uint64_t start = latency_now();
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, SMCIOC_EXCHANGE_MEDIUM, &exchange_medium);
+    error = ret ? errno : 0;
+    latency_record(LATENCY_EXCHANGE, self->path, robot, dest1, start);
+    Py_END_ALLOW_THREADS
+    changer_device_release(self);
+    if (error == ENOTTY || error == EOPNOTSUPP || error == ENOSYS) {
+        PyErr_SetString(PyExc_NotImplementedError, "Exchange medium is not supported by the library");
+        return NULL;
+    }
+    if (ret) {
+        PyErr_SetString(PyExc_ValueError, "Failed to exchange cartridges");
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *method_get_inventory(ChangerDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    int fd = changer_device_acquire(self);
+    if (fd < 0) {
         return NULL;
     }
-    
-    struct element_status robot_status[element_info.robots];
-    struct element_status slot_status[element_info.slots];
-    struct element_status ie_status[element_info.ie_stations];
-    struct element_status drive_status[element_info.drives];
-    struct inventory inventory;
 
-    inventory.robot_status = robot_status;
-    inventory.slot_status = slot_status;
-    if (element_info.ie_stations > 0) {
-        inventory.ie_status = ie_status;
+    struct element_status *elements;
+    unsigned char *types;
+    Py_ssize_t count;
+    int ret;
+    uint64_t start = latency_now();
+    Py_BEGIN_ALLOW_THREADS
+    ret = read_inventory(fd, &elements, &types, &count);
+    latency_record(LATENCY_INVENTORY, self->path, LATENCY_NO_ADDRESS, LATENCY_NO_ADDRESS, start);
+    Py_END_ALLOW_THREADS
+    changer_device_release(self);
+    if (ret != INVENTORY_OK) {
+        return inventory_error(ret);
     }
-    inventory.drive_status = drive_status;
-    
-    if (ioctl(fd, SMCIOC_INVENTORY, &inventory)) {
-        PyErr_SetString(PyExc_ValueError, "Failed to execute inventory command.");
+
+    return inventory_from_records(elements, types, count);
+}
+
+/* Refreshes records of a range of addresses in the given inventory, the elements
+ * are scanned by the library first if requested. */
+static PyObject *method_refresh_range(ChangerDeviceObject *self, PyObject *args) {
+    InventoryObject *inventory;
+    unsigned short first, count;
+    int scan = 0;
+    if(!PyArg_ParseTuple(args, "O!HH|p", &InventoryType, &inventory, &first, &count, &scan)) {
         return NULL;
     }
-    iterate_inventory(&element_info, &inventory, &trim_barcode);
+    if (count == 0) {
+        return PyList_New(0);
+    }
 
-    int err = 0;
+    struct cartridge_location_data *locations = calloc(count, sizeof(struct cartridge_location_data));
+    if (locations == NULL) {
+        return PyErr_NoMemory();
+    }
+    int fd = changer_device_acquire(self);
+    if (fd < 0) {
+        free(locations);
+        return NULL;
+    }
 
-    PyObject *robots_list = PyList_New(element_info.robots);
-    for (int i = 0; i < element_info.robots; i++) {
-        PyObject *robot = PyDict_New();
-        err += PyDict_SetItem(robot, PyUnicode_FromString("address"), PyLong_FromLong(robot_status[i].address));
-        err += PyDict_SetItem(robot, PyUnicode_FromString("tape_source_address"), PyLong_FromLong(robot_status[i].source));
-        err += PyDict_SetItem(robot, PyUnicode_FromString("is_full"), PyBool_FromLong(robot_status[i].full));
-        if (robot_status[i].volume[0] == '\0') err += PyDict_SetItem(robot, PyUnicode_FromString("barcode"), Py_None);
-        else err += PyDict_SetItem(robot, PyUnicode_FromString("barcode"), PyUnicode_FromString((const char *) robot_status[i].volume));
-        PyList_SET_ITEM(robots_list, i, robot);
+    int ret = 0;
+    Py_BEGIN_ALLOW_THREADS
+    if (scan) {
+        struct element_range element_range;
+        element_range.element_address = first;
+        element_range.number_elements = count;
+        ret = dev_ioctl(fd, SMCIOC_INIT_ELEM_STAT_RANGE, &element_range);
     }
+    if (!ret) {
+        struct read_cartridge_location read_cartridge_location;
+        memset(&read_cartridge_location, 0, sizeof(read_cartridge_location));
+        read_cartridge_location.element_address = first;
+        read_cartridge_location.number_elements = count;
+        read_cartridge_location.data = locations;
+        ret = dev_ioctl(fd, SMCIOC_READ_CARTRIDGE_LOCATION, &read_cartridge_location);
+    }
+    Py_END_ALLOW_THREADS
+    changer_device_release(self);
+    if (ret) {
+        free(locations);
+        PyErr_SetString(PyExc_ValueError, "Failed to read status of the elements");
+        return NULL;
+    }
+
+    PyObject *changed = inventory_merge_locations(inventory, locations, count);
+    free(locations);
 
-    PyObject *slots_list = PyList_New(element_info.slots);
-    for (int i = 0; i < element_info.slots; i++) {
-        PyObject *slot = PyDict_New();
-        err += PyDict_SetItem(slot, PyUnicode_FromString("address"), PyLong_FromLong(slot_status[i].address));
-        err += PyDict_SetItem(slot, PyUnicode_FromString("tape_source_address"), PyLong_FromLong(slot_status[i].source));
-        err += PyDict_SetItem(slot, PyUnicode_FromString("is_full"), PyBool_FromLong(slot_status[i].full));
-        if (slot_status[i].volume[0] == '\0') err += PyDict_SetItem(slot, PyUnicode_FromString("barcode"), Py_None);
-        else err += PyDict_SetItem(slot, PyUnicode_FromString("barcode"), PyUnicode_FromString((const char *) slot_status[i].volume));
-        PyList_SET_ITEM(slots_list, i, slot);
+    return changed;
+}
+
+/* Cheap status of one element, polled e.g. until an unloaded drive gives the cartridge up */
+static PyObject *method_element_access(ChangerDeviceObject *self, PyObject *args) {
+    unsigned short address;
+    if(!PyArg_ParseTuple(args, "H", &address)) {
+        return NULL;
     }
 
-    PyObject *ie_stations_list = PyList_New(element_info.ie_stations);
-    for (int i = 0; i < element_info.ie_stations; i++) {
-        PyObject *ie_station = PyDict_New();
-        err += PyDict_SetItem(ie_station, PyUnicode_FromString("address"), PyLong_FromLong(ie_status[i].address));
-        err += PyDict_SetItem(ie_station, PyUnicode_FromString("tape_source_address"), PyLong_FromLong(ie_status[i].source));
-        err += PyDict_SetItem(ie_station, PyUnicode_FromString("is_full"), PyBool_FromLong(ie_status[i].full));
-        if (ie_status[i].volume[0] == '\0') err += PyDict_SetItem(ie_station, PyUnicode_FromString("barcode"), Py_None);
-        else err += PyDict_SetItem(ie_station, PyUnicode_FromString("barcode"), PyUnicode_FromString((const char *) ie_status[i].volume));
-        PyList_SET_ITEM(ie_stations_list, i, ie_station);
+    int fd = changer_device_acquire(self);
+    if (fd < 0) {
+        return NULL;
     }
 
-    PyObject *drives_list = PyList_New(element_info.drives);
-    for (int i = 0; i < element_info.drives; i++) {
-        PyObject *drive = PyDict_New();
-        err += PyDict_SetItem(drive, PyUnicode_FromString("address"), PyLong_FromLong(drive_status[i].address));
-        err += PyDict_SetItem(drive, PyUnicode_FromString("tape_source_address"), PyLong_FromLong(drive_status[i].source));
-        err += PyDict_SetItem(drive, PyUnicode_FromString("is_full"), PyBool_FromLong(drive_status[i].full));
-        if (drive_status[i].volume[0] == '\0') err += PyDict_SetItem(drive, PyUnicode_FromString("barcode"), Py_None);
-        else err += PyDict_SetItem(drive, PyUnicode_FromString("barcode"), PyUnicode_FromString((const char *) drive_status[i].volume));
-        PyList_SET_ITEM(drives_list, i, drive);
+    struct cartridge_location_data location;
+    struct read_cartridge_location read_cartridge_location;
+    memset(&location, 0, sizeof(location));
+    memset(&read_cartridge_location, 0, sizeof(read_cartridge_location));
+    read_cartridge_location.element_address = address;
+    read_cartridge_location.number_elements = 1;
+    read_cartridge_location.data = &location;
+
+    int ret;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, SMCIOC_READ_CARTRIDGE_LOCATION, &read_cartridge_location);
+    Py_END_ALLOW_THREADS
+    changer_device_release(self);
+    if (ret) {
+        PyErr_SetString(PyExc_ValueError, "Failed to read status of the element");
+        return NULL;
     }
 
-    PyObject *output = PyDict_New();
-    err += PyDict_SetItem(output, PyUnicode_FromString("robots"), robots_list);
-    err += PyDict_SetItem(output, PyUnicode_FromString("slots"), slots_list);
-    err += PyDict_SetItem(output, PyUnicode_FromString("ie_stations"), ie_stations_list);
-    err += PyDict_SetItem(output, PyUnicode_FromString("drives"), drives_list);
+    return Py_BuildValue("(NN)", PyBool_FromLong(location.full), PyBool_FromLong(location.access));
+}
 
-    if (err > 0) {
-        PyErr_SetString(PyExc_ValueError, "Failed to execute inventory command.");
+static PyObject *method_read_element_devids(ChangerDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    int fd = changer_device_acquire(self);
+    if (fd < 0) {
         return NULL;
     }
 
+    struct element_info element_info;
+    struct element_devid *devids = NULL;
+    int ret;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, SMCIOC_ELEMENT_INFO, &element_info);
+    if (!ret) {
+        devids = calloc(element_info.drives > 0 ? element_info.drives : 1, sizeof(struct element_devid));
+        if (devids != NULL && element_info.drives > 0) {
+            struct read_element_devids read_element_devids;
+            read_element_devids.element_address = element_info.drive_addr;
+            read_element_devids.number_elements = element_info.drives;
+            read_element_devids.drive_devid = devids;
+            ret = dev_ioctl(fd, SMCIOC_READ_ELEMENT_DEVIDS, &read_element_devids);
+        }
+    }
+    Py_END_ALLOW_THREADS
+    changer_device_release(self);
+    if (ret) {
+        free(devids);
+        PyErr_SetString(PyExc_ValueError, "Failed to read device ids of the drives");
+        return NULL;
+    }
+    if (devids == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    PyObject *output = PyList_New(element_info.drives);
+    for (int i = 0; output != NULL && i < element_info.drives; i++) {
+        struct element_devid *devid = &devids[i];
+        int length = devid->ident_len < sizeof(devid->identifier) ? devid->ident_len : sizeof(devid->identifier);
+        while (length > 0 && (devid->identifier[length - 1] == ' ' || devid->identifier[length - 1] == '\0')) length--;
+        PyObject *item = Py_BuildValue("(HOs#)", devid->address, devid->full ? Py_True : Py_False, (const char *) devid->identifier, (Py_ssize_t) length);
+        if (item == NULL) {
+            Py_CLEAR(output);
+            break;
+        }
+        PyList_SET_ITEM(output, i, item);
+    }
+    free(devids);
+
     return output;
 }
 
-static PyMethodDef changer_methods[] = {
-    {"_get_inventory", method_get_inventory, METH_VARARGS, "Loads cached inventory of the library"},
-    {"_move_cartridge", method_move_cartridge, METH_VARARGS, "Move cartidge from the source to the destination"},
+typedef struct {
+    ChangerDeviceObject *device;
+    int fd;
+    struct element_status *elements;
+    unsigned char *types;
+    Py_ssize_t count;
+    int error;
+    pthread_t thread;
+    int thread_started;
+} InventoryJob;
+
+static void *inventory_thread(void *arg) {
+    InventoryJob *job = (InventoryJob *) arg;
+    uint64_t start = latency_now();
+    job->error = read_inventory(job->fd, &job->elements, &job->types, &job->count);
+    latency_record(LATENCY_INVENTORY, job->device->path, LATENCY_NO_ADDRESS, LATENCY_NO_ADDRESS, start);
+    return NULL;
+}
+
+/* Reads inventories of all devices at once, one thread per device. A library which
+ * failed gets the exception object in its place, so the others are still usable. */
+static PyObject *method_inventory_all(PyObject *module, PyObject *args) {
+    PyObject *devices;
+    if(!PyArg_ParseTuple(args, "O", &devices)) {
+        return NULL;
+    }
+    PyObject *sequence = PySequence_Fast(devices, "Devices have to be a sequence of changer devices.");
+    if (sequence == NULL) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(sequence);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        if (!PyObject_TypeCheck(PySequence_Fast_GET_ITEM(sequence, i), &ChangerDeviceType)) {
+            Py_DECREF(sequence);
+            PyErr_SetString(PyExc_TypeError, "Devices have to be changer devices.");
+            return NULL;
+        }
+    }
+    InventoryJob *jobs = calloc(count > 0 ? count : 1, sizeof(InventoryJob));
+    if (jobs == NULL) {
+        Py_DECREF(sequence);
+        return PyErr_NoMemory();
+    }
+
+    Py_ssize_t acquired = 0;
+    for (; acquired < count; acquired++) {
+        jobs[acquired].device = (ChangerDeviceObject *) PySequence_Fast_GET_ITEM(sequence, acquired);
+        jobs[acquired].fd = changer_device_acquire(jobs[acquired].device);
+        if (jobs[acquired].fd < 0) {
+            break;
+        }
+    }
+    if (acquired < count) {
+        for (Py_ssize_t i = 0; i < acquired; i++) changer_device_release(jobs[i].device);
+        free(jobs);
+        Py_DECREF(sequence);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t i = 0; i < count; i++) {
+        jobs[i].thread_started = pthread_create(&jobs[i].thread, NULL, inventory_thread, &jobs[i]) == 0;
+        if (!jobs[i].thread_started) inventory_thread(&jobs[i]);
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        if (jobs[i].thread_started) pthread_join(jobs[i].thread, NULL);
+    }
+    Py_END_ALLOW_THREADS
+
+    PyObject *output = PyList_New(count);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        changer_device_release(jobs[i].device);
+        PyObject *item;
+        if (jobs[i].error == INVENTORY_OK) {
+            item = inventory_from_records(jobs[i].elements, jobs[i].types, jobs[i].count);
+        } else {
+            PyObject *type, *value, *traceback;
+            inventory_error(jobs[i].error);
+            PyErr_Fetch(&type, &value, &traceback);
+            PyErr_NormalizeException(&type, &value, &traceback);
+            Py_XDECREF(type);
+            Py_XDECREF(traceback);
+            item = value;
+        }
+        if (output != NULL && item != NULL) {
+            PyList_SET_ITEM(output, i, item);
+        } else {
+            Py_XDECREF(item);
+            Py_CLEAR(output);
+        }
+    }
+    free(jobs);
+    Py_DECREF(sequence);
+
+    return output;
+}
+
+static int changer_device_init(ChangerDeviceObject *self, PyObject *args, PyObject *kwds) {
+    char *path;
+    if(!PyArg_ParseTuple(args, "s", &path)) {
+        return -1;
+    }
+
+    if (self->fd >= 0) {
+        dev_close(self->fd);
+    }
+    free(self->path);
+    self->path = strdup(path);
+    if (self->path == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->fd = dev_open(path, O_RDWR);
+    if (self->fd < 0) {
+        PyErr_SetString(PyExc_ValueError, "Failed to open changer ioctl device.");
+        return -1;
+    }
+
+    return 0;
+}
+
+static PyObject *changer_device_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    ChangerDeviceObject *self = (ChangerDeviceObject *) type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->fd = -1;
+    }
+    return (PyObject *) self;
+}
+
+static void changer_device_dealloc(ChangerDeviceObject *self) {
+    if (self->fd >= 0) {
+        dev_close(self->fd);
+    }
+    free(self->path);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *method_close(ChangerDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->in_use > 0) {
+        PyErr_SetString(PyExc_ValueError, "Device is busy.");
+        return NULL;
+    }
+    if (self->fd >= 0) {
+        dev_close(self->fd);
+        self->fd = -1;
+    }
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *method_enter(ChangerDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (changer_device_acquire(self) < 0) {
+        return NULL;
+    }
+    changer_device_release(self);
+
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
+static PyObject *method_exit(ChangerDeviceObject *self, PyObject *args) {
+    return method_close(self, NULL);
+}
+
+static PyObject *changer_device_get_closed(ChangerDeviceObject *self, void *closure) {
+    return PyBool_FromLong(self->fd < 0);
+}
+
+static PyMethodDef changer_device_methods[] = {
+    {"get_inventory", (PyCFunction) method_get_inventory, METH_NOARGS, "Loads cached inventory of the library"},
+    {"move_cartridge", (PyCFunction) method_move_cartridge, METH_VARARGS, "Move cartidge from the source to the destination"},
+    {"refresh_range", (PyCFunction) method_refresh_range, METH_VARARGS, "Read status of count elements from the first address into the inventory, returns changed indexes"},
+    {"element_access", (PyCFunction) method_element_access, METH_VARARGS, "Return (is_full, accessible) of the element"},
+    {"read_element_devids", (PyCFunction) method_read_element_devids, METH_NOARGS, "List (address, is_full, identifier) of the drives"},
+    {"position_robot", (PyCFunction) method_position_robot, METH_VARARGS, "Move the empty robot in front of the destination"},
+    {"exchange_cartridge", (PyCFunction) method_exchange_cartridge, METH_VARARGS, "Move cartridge from the source to the first destination and the one from there to the second destination"},
+    {"close", (PyCFunction) method_close, METH_NOARGS, "Close the device"},
+    {"__enter__", (PyCFunction) method_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction) method_exit, METH_VARARGS, NULL},
     {NULL, NULL, 0, NULL}
 };
 
+static PyGetSetDef changer_device_getset[] = {
+    {"closed", (getter) changer_device_get_closed, NULL, "True if the device is closed", NULL},
+    {NULL}
+};
+
+PyTypeObject ChangerDeviceType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.changer.ChangerDevice",
+    .tp_doc = "Open handle of the lin_tape changer device",
+    .tp_basicsize = sizeof(ChangerDeviceObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = changer_device_new,
+    .tp_init = (initproc) changer_device_init,
+    .tp_dealloc = (destructor) changer_device_dealloc,
+    .tp_methods = changer_device_methods,
+    .tp_getset = changer_device_getset,
+};
+
+
+static PyMethodDef changer_module_methods[] = {
+    {"inventory_all", (PyCFunction) method_inventory_all, METH_VARARGS, "Read inventories of all given changer devices concurrently"},
+    {"latency_snapshot", (PyCFunction) latency_snapshot, METH_NOARGS, "Latency histograms of the changer operations"},
+    {"latency_reset", (PyCFunction) latency_reset, METH_NOARGS, "Drop all latency histograms of the changer operations"},
+    {NULL, NULL, 0, NULL}
+};
 
 static struct PyModuleDef changer_module = {
     PyModuleDef_HEAD_INIT,
     "changer",
     "Python interface for the tape changer",
     -1,
-    changer_methods
+    changer_module_methods
 };
 
 PyMODINIT_FUNC PyInit_changer(void) {
-    return PyModule_Create(&changer_module);
+    if (PyType_Ready(&ChangerDeviceType) < 0 || PyType_Ready(&InventoryType) < 0 || PyType_Ready(&MoveSchedulerType) < 0) {
+        return NULL;
+    }
+
+    PyObject *module = PyModule_Create(&changer_module);
+    if (module == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(&ChangerDeviceType);
+    if (PyModule_AddObject(module, "ChangerDevice", (PyObject *) &ChangerDeviceType) < 0) {
+        Py_DECREF(&ChangerDeviceType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&InventoryType);
+    if (PyModule_AddObject(module, "Inventory", (PyObject *) &InventoryType) < 0) {
+        Py_DECREF(&InventoryType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&MoveSchedulerType);
+    if (PyModule_AddObject(module, "MoveScheduler", (PyObject *) &MoveSchedulerType) < 0) {
+        Py_DECREF(&MoveSchedulerType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    return module;
 }
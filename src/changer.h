@@ -0,0 +1,45 @@
+#ifndef TAPES_CHANGER_H
+#define TAPES_CHANGER_H
+
+#include <Python.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <linux/version.h>
+#include "IBM_tape.h"
+
+
+/* Values match LibraryElementType in tapes/changer.py */
+enum element_type {TYPE_DRIVE, TYPE_SLOT, TYPE_IE_STATION, TYPE_ROBOT};
+
+typedef struct {
+    PyObject_HEAD
+    int fd;
+    int in_use;
+    char *path;
+} ChangerDeviceObject;
+
+/* Element status records of a library packed in one array, robots first,
+ * then slots, drives and import/export stations. */
+typedef struct {
+    PyObject_HEAD
+    Py_ssize_t count;
+    struct element_status *elements;
+    unsigned char *types;
+} InventoryObject;
+
+extern PyTypeObject ChangerDeviceType;
+extern PyTypeObject InventoryType;
+extern PyTypeObject MoveSchedulerType;
+
+/* Marks the device as used by a call which may release the GIL, so the
+ * descriptor cannot be closed by another thread in the meantime. */
+int changer_device_acquire(ChangerDeviceObject *self);
+void changer_device_release(ChangerDeviceObject *self);
+
+/* Takes ownership of malloc'ed records. */
+PyObject *inventory_from_records(struct element_status *elements, unsigned char *types, Py_ssize_t count);
+
+/* Merges cartridge locations into the inventory, returns a list of changed indexes. */
+PyObject *inventory_merge_locations(InventoryObject *self, const struct cartridge_location_data *locations, int count);
+
+#endif
@@ -0,0 +1,128 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "device.h"
+
+#define SIM_TAPE_PREFIX "sim:tape:"
+#define SIM_CHANGER_PREFIX "sim:changer:"
+
+
+typedef struct {
+    const DeviceOps *ops;
+    void *state;
+} DeviceEntry;
+
+/* Simulated devices indexed by their descriptor, real devices have no entry */
+static DeviceEntry *device_table;
+static int device_table_size;
+static pthread_mutex_t device_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int device_lookup(int fd, DeviceEntry *entry) {
+    pthread_mutex_lock(&device_lock);
+    int found = fd >= 0 && fd < device_table_size && device_table[fd].ops != NULL;
+    if (found) *entry = device_table[fd];
+    pthread_mutex_unlock(&device_lock);
+    return found;
+}
+
+static int device_register(int fd, const DeviceOps *ops, void *state) {
+    pthread_mutex_lock(&device_lock);
+    if (fd >= device_table_size) {
+        int size = device_table_size ? device_table_size : 16;
+        while (size <= fd) size *= 2;
+        DeviceEntry *table = realloc(device_table, size * sizeof(DeviceEntry));
+        if (table == NULL) {
+            pthread_mutex_unlock(&device_lock);
+            errno = ENOMEM;
+            return -1;
+        }
+        memset(table + device_table_size, 0, (size - device_table_size) * sizeof(DeviceEntry));
+        device_table = table;
+        device_table_size = size;
+    }
+    device_table[fd].ops = ops;
+    device_table[fd].state = state;
+    pthread_mutex_unlock(&device_lock);
+    return 0;
+}
+
+int dev_open(const char *path, int flags) {
+    const DeviceOps *ops = NULL;
+    void *state;
+    if (!strncmp(path, SIM_TAPE_PREFIX, strlen(SIM_TAPE_PREFIX))) {
+        state = sim_tape_open(path + strlen(SIM_TAPE_PREFIX), &ops);
+    } else if (!strncmp(path, SIM_CHANGER_PREFIX, strlen(SIM_CHANGER_PREFIX))) {
+        state = sim_changer_open(path + strlen(SIM_CHANGER_PREFIX), &ops);
+    } else {
+        return open(path, flags);
+    }
+    if (state == NULL) {
+        return -1;
+    }
+
+    int fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || device_register(fd, ops, state) < 0) {
+        int error = errno;
+        if (fd >= 0) close(fd);
+        ops->close(state);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+int dev_ioctl(int fd, unsigned long request, void *arg) {
+    DeviceEntry entry;
+    if (device_lookup(fd, &entry)) {
+        return entry.ops->ioctl(entry.state, request, arg);
+    }
+    return ioctl(fd, request, arg);
+}
+
+ssize_t dev_read(int fd, void *buffer, size_t length) {
+    DeviceEntry entry;
+    if (device_lookup(fd, &entry)) {
+        return entry.ops->read(entry.state, buffer, length);
+    }
+    return read(fd, buffer, length);
+}
+
+ssize_t dev_write(int fd, const void *buffer, size_t length) {
+    DeviceEntry entry;
+    if (device_lookup(fd, &entry)) {
+        return entry.ops->write(entry.state, buffer, length);
+    }
+    return write(fd, buffer, length);
+}
+
+int dev_close(int fd) {
+    DeviceEntry entry;
+    int simulated = 0;
+    pthread_mutex_lock(&device_lock);
+    if (fd >= 0 && fd < device_table_size && device_table[fd].ops != NULL) {
+        entry = device_table[fd];
+        device_table[fd].ops = NULL;
+        device_table[fd].state = NULL;
+        simulated = 1;
+    }
+    pthread_mutex_unlock(&device_lock);
+    if (simulated) {
+        entry.ops->close(entry.state);
+    }
+    return close(fd);
+}
+
+void sim_sleep(double seconds) {
+    if (seconds <= 0) {
+        return;
+    }
+    struct timespec duration;
+    duration.tv_sec = (time_t) seconds;
+    duration.tv_nsec = (long) ((seconds - (double) duration.tv_sec) * 1e9);
+    while (nanosleep(&duration, &duration) && errno == EINTR);
+}
@@ -0,0 +1,31 @@
+#ifndef TAPES_DEVICE_H
+#define TAPES_DEVICE_H
+
+#include <sys/types.h>
+
+
+/* Descriptors of the devices go through the calls below, so a simulator can stand
+ * in for lin_tape. "sim:tape:<directory>" and "sim:changer:<file>" open the file
+ * backed simulators, any other path is opened as a real device. A simulated
+ * device still owns a real descriptor, which only identifies it. */
+typedef struct {
+    int (*ioctl)(void *state, unsigned long request, void *arg);
+    ssize_t (*read)(void *state, void *buffer, size_t length);
+    ssize_t (*write)(void *state, const void *buffer, size_t length);
+    void (*close)(void *state);
+} DeviceOps;
+
+int dev_open(const char *path, int flags);
+int dev_ioctl(int fd, unsigned long request, void *arg);
+ssize_t dev_read(int fd, void *buffer, size_t length);
+ssize_t dev_write(int fd, const void *buffer, size_t length);
+int dev_close(int fd);
+
+/* Backends return their state, or NULL with errno set. */
+void *sim_tape_open(const char *directory, const DeviceOps **ops);
+void *sim_changer_open(const char *file, const DeviceOps **ops);
+
+/* Simulated time of an operation, called without the GIL and the device lock. */
+void sim_sleep(double seconds);
+
+#endif
@@ -0,0 +1,287 @@
+#include <Python.h>
+#include <stdlib.h>
+#include <string.h>
+#include "changer.h"
+
+
+PyObject *inventory_from_records(struct element_status *elements, unsigned char *types, Py_ssize_t count) {
+    InventoryObject *self = PyObject_New(InventoryObject, &InventoryType);
+    if (self == NULL) {
+        free(elements);
+        free(types);
+        return NULL;
+    }
+    self->count = count;
+    self->elements = elements;
+    self->types = types;
+    return (PyObject *) self;
+}
+
+static void inventory_dealloc(InventoryObject *self) {
+    free(self->elements);
+    free(self->types);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static Py_ssize_t inventory_length(InventoryObject *self) {
+    return self->count;
+}
+
+/* Elements are materialized as (element_type, address, tape_source_address, is_full, barcode) */
+static PyObject *inventory_item(InventoryObject *self, Py_ssize_t index) {
+    if (index < 0 || index >= self->count) {
+        PyErr_SetString(PyExc_IndexError, "Inventory index out of range");
+        return NULL;
+    }
+    struct element_status *status = &self->elements[index];
+    PyObject *barcode;
+    if (status->volume[0] == '\0') {
+        Py_INCREF(Py_None);
+        barcode = Py_None;
+    } else {
+        barcode = PyUnicode_FromString((const char *) status->volume);
+        if (barcode == NULL) {
+            return NULL;
+        }
+    }
+    return Py_BuildValue("(iiiNN)", self->types[index], status->address, status->source, PyBool_FromLong(status->full), barcode);
+}
+
+static PyObject *method_find(InventoryObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"element_type", "is_full", "barcode", NULL};
+    PyObject *type_arg = Py_None, *full_arg = Py_None;
+    const char *barcode = NULL;
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "|OOz", kwlist, &type_arg, &full_arg, &barcode)) {
+        return NULL;
+    }
+    long type = -1;
+    if (type_arg != Py_None) {
+        type = PyLong_AsLong(type_arg);
+        if (type == -1 && PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+    int full = -1;
+    if (full_arg != Py_None) {
+        full = PyObject_IsTrue(full_arg);
+        if (full < 0) {
+            return NULL;
+        }
+    }
+
+    PyObject *output = PyList_New(0);
+    if (output == NULL) {
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < self->count; i++) {
+        struct element_status *status = &self->elements[i];
+        if (type >= 0 && self->types[i] != type) continue;
+        if (full >= 0 && status->full != full) continue;
+        if (barcode != NULL && strncmp((const char *) status->volume, barcode, sizeof(status->volume))) continue;
+        PyObject *index = PyLong_FromSsize_t(i);
+        if (index == NULL || PyList_Append(output, index) < 0) {
+            Py_XDECREF(index);
+            Py_DECREF(output);
+            return NULL;
+        }
+        Py_DECREF(index);
+    }
+
+    return output;
+}
+
+static Py_ssize_t inventory_index_of(InventoryObject *self, unsigned int address) {
+    for (Py_ssize_t i = 0; i < self->count; i++) {
+        if (self->elements[i].address == address) return i;
+    }
+    return -1;
+}
+
+/* Puts the cartridge described by the record into the destination record */
+static void inventory_place(struct element_status *destination, const struct element_status *record, unsigned char type) {
+    int from_storage = type == TYPE_SLOT || type == TYPE_IE_STATION;
+    destination->full = 1;
+    destination->svalid = from_storage || record->svalid;
+    destination->source = from_storage ? record->address : record->source;
+    memcpy(destination->volume, record->volume, sizeof(destination->volume));
+}
+
+static void inventory_empty(struct element_status *status) {
+    status->full = 0;
+    status->svalid = 0;
+    status->source = 0;
+    memset(status->volume, 0, sizeof(status->volume));
+}
+
+/* Replaces records of the elements found in the inventory by the cartridge
+ * locations read from the library, returns indexes of the changed records. */
+PyObject *inventory_merge_locations(InventoryObject *self, const struct cartridge_location_data *locations, int count) {
+    PyObject *output = PyList_New(0);
+    if (output == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        const struct cartridge_location_data *location = &locations[i];
+        Py_ssize_t index = inventory_index_of(self, location->address);
+        if (index < 0) continue;
+
+        struct element_status updated = self->elements[index];
+        updated.full = location->full;
+        updated.access = location->access;
+        updated.except = location->except;
+        updated.asc = location->asc;
+        updated.ascq = location->ascq;
+        updated.svalid = location->full && location->svalid;
+        updated.source = updated.svalid ? location->source : 0;
+        memset(updated.volume, 0, sizeof(updated.volume));
+        if (location->full) {
+            size_t length = 0;
+            while (length < sizeof(location->volume) && location->volume[length] != ' ' && location->volume[length] != '\0') length++;
+            if (length == sizeof(updated.volume)) length--;
+            memcpy(updated.volume, location->volume, length);
+        }
+        if (!memcmp(&updated, &self->elements[index], sizeof(updated))) continue;
+
+        self->elements[index] = updated;
+        PyObject *changed = PyLong_FromSsize_t(index);
+        if (changed == NULL || PyList_Append(output, changed) < 0) {
+            Py_XDECREF(changed);
+            Py_DECREF(output);
+            return NULL;
+        }
+        Py_DECREF(changed);
+    }
+
+    return output;
+}
+
+/* Updates records after a successful move, returns indexes of both elements */
+static PyObject *method_apply_move(InventoryObject *self, PyObject *args) {
+    unsigned short source_address, destination_address;
+    if(!PyArg_ParseTuple(args, "HH", &source_address, &destination_address)) {
+        return NULL;
+    }
+    Py_ssize_t source_index = inventory_index_of(self, source_address);
+    Py_ssize_t destination_index = inventory_index_of(self, destination_address);
+    if (source_index < 0 || destination_index < 0) {
+        PyErr_SetString(PyExc_KeyError, "Element is not in the inventory");
+        return NULL;
+    }
+
+    if (source_index != destination_index) {
+        struct element_status source = self->elements[source_index];
+        inventory_place(&self->elements[destination_index], &source, self->types[source_index]);
+        inventory_empty(&self->elements[source_index]);
+    }
+
+    return Py_BuildValue("(nn)", source_index, destination_index);
+}
+
+/* Updates records after a successful exchange, returns indexes of all three elements */
+static PyObject *method_apply_exchange(InventoryObject *self, PyObject *args) {
+    unsigned short source_address, first_address, second_address;
+    if(!PyArg_ParseTuple(args, "HHH", &source_address, &first_address, &second_address)) {
+        return NULL;
+    }
+    Py_ssize_t source_index = inventory_index_of(self, source_address);
+    Py_ssize_t first_index = inventory_index_of(self, first_address);
+    Py_ssize_t second_index = inventory_index_of(self, second_address);
+    if (source_index < 0 || first_index < 0 || second_index < 0) {
+        PyErr_SetString(PyExc_KeyError, "Element is not in the inventory");
+        return NULL;
+    }
+
+    struct element_status source = self->elements[source_index];
+    struct element_status first = self->elements[first_index];
+    if (second_index != source_index) {
+        inventory_empty(&self->elements[source_index]);
+    }
+    inventory_place(&self->elements[first_index], &source, self->types[source_index]);
+    inventory_place(&self->elements[second_index], &first, self->types[first_index]);
+
+    return Py_BuildValue("(nnn)", source_index, first_index, second_index);
+}
+
+static PySequenceMethods inventory_as_sequence = {
+    .sq_length = (lenfunc) inventory_length,
+    .sq_item = (ssizeargfunc) inventory_item,
+};
+
+static int inventory_record_differs(const struct element_status *first, const struct element_status *second) {
+    if (first->full != second->full || first->svalid != second->svalid) return 1;
+    if (first->svalid && first->source != second->source) return 1;
+    return strncmp((const char *) first->volume, (const char *) second->volume, sizeof(first->volume)) != 0;
+}
+
+static int append_index_pair(PyObject *output, Py_ssize_t first, Py_ssize_t second) {
+    PyObject *pair = Py_BuildValue("(nn)", first, second);
+    if (pair == NULL || PyList_Append(output, pair) < 0) {
+        Py_XDECREF(pair);
+        return -1;
+    }
+    Py_DECREF(pair);
+    return 0;
+}
+
+/* Compares with a newer inventory, returns (index, other_index) pairs of the elements
+ * whose full flag, source or barcode differ, -1 for an element missing on one side. */
+static PyObject *method_diff(InventoryObject *self, PyObject *args) {
+    InventoryObject *other;
+    if(!PyArg_ParseTuple(args, "O!", &InventoryType, &other)) {
+        return NULL;
+    }
+
+    PyObject *output = PyList_New(0);
+    if (output == NULL) {
+        return NULL;
+    }
+    char *matched = calloc(other->count > 0 ? other->count : 1, 1);
+    if (matched == NULL) {
+        Py_DECREF(output);
+        return PyErr_NoMemory();
+    }
+    for (Py_ssize_t i = 0; i < self->count; i++) {
+        struct element_status *status = &self->elements[i];
+        /* Both inventories have the same layout unless the library was reconfigured */
+        Py_ssize_t j = i;
+        if (j >= other->count || other->elements[j].address != status->address) {
+            j = inventory_index_of(other, status->address);
+        }
+        if (j >= 0) {
+            matched[j] = 1;
+            if (!inventory_record_differs(status, &other->elements[j])) continue;
+        }
+        if (append_index_pair(output, i, j) < 0) {
+            Py_CLEAR(output);
+            break;
+        }
+    }
+    for (Py_ssize_t j = 0; output != NULL && j < other->count; j++) {
+        if (!matched[j] && append_index_pair(output, -1, j) < 0) {
+            Py_CLEAR(output);
+        }
+    }
+    free(matched);
+
+    return output;
+}
+
+static PyMethodDef inventory_methods[] = {
+    {"apply_move", (PyCFunction) method_apply_move, METH_VARARGS, "Move the cartridge between records of the source and the destination"},
+    {"apply_exchange", (PyCFunction) method_apply_exchange, METH_VARARGS, "Exchange cartridges between records like the exchange medium command"},
+    {"diff", (PyCFunction) method_diff, METH_VARARGS, "Pairs of indexes of elements which differ from the other inventory"},
+    {"find", (PyCFunction) method_find, METH_VARARGS | METH_KEYWORDS, "Indexes of elements matching the type, the full flag and the barcode"},
+    {NULL, NULL, 0, NULL}
+};
+
+PyTypeObject InventoryType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.changer.Inventory",
+    .tp_doc = "Packed element status records of the library",
+    .tp_basicsize = sizeof(InventoryObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor) inventory_dealloc,
+    .tp_as_sequence = &inventory_as_sequence,
+    .tp_methods = inventory_methods,
+};
@@ -0,0 +1,139 @@
+#include <Python.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "latency.h"
+
+#define LATENCY_TABLE_SIZE 256
+
+
+static const char *latency_operation_names[LATENCY_OPERATIONS] = {
+    "move", "exchange", "position", "inventory",
+    "locate", "rewind", "load", "unload",
+    "sync", "partition"
+};
+
+typedef struct LatencyHistogram {
+    int operation;
+    char *device;
+    int robot;
+    int element;
+    unsigned long long count;
+    unsigned long long total_ns;
+    unsigned long long max_ns;
+    unsigned long long buckets[LATENCY_BUCKETS];
+    struct LatencyHistogram *next;
+} LatencyHistogram;
+
+/* Histograms live until reset, the table is shared by all devices of the extension */
+static LatencyHistogram *latency_table[LATENCY_TABLE_SIZE];
+static pthread_mutex_t latency_lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t latency_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+static unsigned int latency_hash(int operation, const char *device, int robot, int element) {
+    unsigned int hash = 2166136261u;
+    for (const char *c = device; *c; c++) hash = (hash ^ (unsigned char) *c) * 16777619u;
+    hash = (hash ^ (unsigned int) operation) * 16777619u;
+    hash = (hash ^ (unsigned int) robot) * 16777619u;
+    hash = (hash ^ (unsigned int) element) * 16777619u;
+    return hash % LATENCY_TABLE_SIZE;
+}
+
+static int latency_bucket(uint64_t elapsed_ns) {
+    uint64_t us = elapsed_ns / 1000;
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && us >= (1ULL << bucket)) bucket++;
+    return bucket;
+}
+
+void latency_record(int operation, const char *device, int robot, int element, uint64_t start) {
+    uint64_t elapsed = latency_now() - start;
+    if (device == NULL) device = "";
+    unsigned int hash = latency_hash(operation, device, robot, element);
+
+    pthread_mutex_lock(&latency_lock);
+    LatencyHistogram *histogram = latency_table[hash];
+    while (histogram != NULL && (histogram->operation != operation || histogram->robot != robot || histogram->element != element || strcmp(histogram->device, device))) {
+        histogram = histogram->next;
+    }
+    if (histogram == NULL) {
+        histogram = calloc(1, sizeof(LatencyHistogram));
+        char *copy = strdup(device);
+        if (histogram == NULL || copy == NULL) {
+            /* Samples are dropped rather than failing the measured operation */
+            free(histogram);
+            free(copy);
+            pthread_mutex_unlock(&latency_lock);
+            return;
+        }
+        histogram->operation = operation;
+        histogram->device = copy;
+        histogram->robot = robot;
+        histogram->element = element;
+        histogram->next = latency_table[hash];
+        latency_table[hash] = histogram;
+    }
+    histogram->count++;
+    histogram->total_ns += elapsed;
+    if (elapsed > histogram->max_ns) histogram->max_ns = elapsed;
+    histogram->buckets[latency_bucket(elapsed)]++;
+    pthread_mutex_unlock(&latency_lock);
+}
+
+static PyObject *latency_address(int address) {
+    if (address == LATENCY_NO_ADDRESS) {
+        Py_RETURN_NONE;
+    }
+    return PyLong_FromLong(address);
+}
+
+/* Returns tuples (operation, device, robot, element, count, total_ns, max_ns, buckets) */
+PyObject *latency_snapshot(PyObject *module, PyObject *Py_UNUSED(ignored)) {
+    PyObject *output = PyList_New(0);
+    if (output == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&latency_lock);
+    for (int i = 0; i < LATENCY_TABLE_SIZE && output != NULL; i++) {
+        for (LatencyHistogram *histogram = latency_table[i]; histogram != NULL; histogram = histogram->next) {
+            PyObject *buckets = PyTuple_New(LATENCY_BUCKETS);
+            for (int j = 0; buckets != NULL && j < LATENCY_BUCKETS; j++) {
+                PyTuple_SET_ITEM(buckets, j, PyLong_FromUnsignedLongLong(histogram->buckets[j]));
+            }
+            PyObject *item = buckets == NULL ? NULL : Py_BuildValue("(ssNNKKKN)", latency_operation_names[histogram->operation], histogram->device, latency_address(histogram->robot), latency_address(histogram->element), histogram->count, histogram->total_ns, histogram->max_ns, buckets);
+            if (item == NULL || PyList_Append(output, item) < 0) {
+                Py_XDECREF(item);
+                Py_CLEAR(output);
+                break;
+            }
+            Py_DECREF(item);
+        }
+    }
+    pthread_mutex_unlock(&latency_lock);
+
+    return output;
+}
+
+PyObject *latency_reset(PyObject *module, PyObject *Py_UNUSED(ignored)) {
+    pthread_mutex_lock(&latency_lock);
+    for (int i = 0; i < LATENCY_TABLE_SIZE; i++) {
+        LatencyHistogram *histogram = latency_table[i];
+        while (histogram != NULL) {
+            LatencyHistogram *next = histogram->next;
+            free(histogram->device);
+            free(histogram);
+            histogram = next;
+        }
+        latency_table[i] = NULL;
+    }
+    pthread_mutex_unlock(&latency_lock);
+
+    Py_RETURN_NONE;
+}
@@ -0,0 +1,29 @@
+#ifndef TAPES_LATENCY_H
+#define TAPES_LATENCY_H
+
+#include <Python.h>
+#include <stdint.h>
+
+/* Bucket i counts operations which took less than 2^i microseconds, the last
+ * one also counts everything longer. */
+#define LATENCY_BUCKETS 32
+#define LATENCY_NO_ADDRESS -1
+
+enum latency_operation {
+    LATENCY_MOVE, LATENCY_EXCHANGE, LATENCY_POSITION, LATENCY_INVENTORY,
+    LATENCY_LOCATE, LATENCY_REWIND, LATENCY_LOAD, LATENCY_UNLOAD,
+    LATENCY_SYNC, LATENCY_PARTITION, LATENCY_OPERATIONS
+};
+
+/* Monotonic time in nanoseconds, taken before the measured call. */
+uint64_t latency_now(void);
+
+/* Records the time since start, may be called without the GIL. Histograms are
+ * kept per operation, device path, robot and element address. */
+void latency_record(int operation, const char *device, int robot, int element, uint64_t start);
+
+/* Module level functions exporting the histograms of the extension. */
+PyObject *latency_snapshot(PyObject *module, PyObject *Py_UNUSED(ignored));
+PyObject *latency_reset(PyObject *module, PyObject *Py_UNUSED(ignored));
+
+#endif
@@ -0,0 +1,459 @@
+#include <Python.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include "changer.h"
+#include "device.h"
+#include "latency.h"
+
+#define ROBOT_POSITION_UNKNOWN 0x10000
+
+
+typedef struct MoveRequest {
+    unsigned long long id;
+    unsigned short source;
+    unsigned short destination;
+    int robot;
+    unsigned short robot_address;
+    int error;
+    struct MoveRequest *next;
+} MoveRequest;
+
+typedef struct {
+    struct MoveSchedulerObject *scheduler;
+    int index;
+    unsigned short address;
+    int position;
+    int busy;
+    pthread_t thread;
+    int thread_started;
+} MoveRobot;
+
+/* Every robot has its own thread issuing one move at a time, all of them share
+ * the descriptor of the device. A queued request is taken by the idle robot
+ * closest to its source element, unless it was submitted for a given robot. */
+typedef struct MoveSchedulerObject {
+    PyObject_HEAD
+    ChangerDeviceObject *device;
+    int fd;
+    int robots_count;
+    MoveRobot *robots;
+    MoveRequest *pending;
+    MoveRequest *pending_tail;
+    MoveRequest *done;
+    MoveRequest *done_tail;
+    unsigned long long next_id;
+    int queued;
+    int in_flight;
+    int closing;
+    int stopped;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} MoveSchedulerObject;
+
+static void request_append(MoveRequest **head, MoveRequest **tail, MoveRequest *request) {
+    request->next = NULL;
+    if (*tail != NULL) (*tail)->next = request;
+    else *head = request;
+    *tail = request;
+}
+
+static void request_free_all(MoveRequest *request) {
+    while (request != NULL) {
+        MoveRequest *next = request->next;
+        free(request);
+        request = next;
+    }
+}
+
+/* Called with the lock held. */
+static int robot_distance(MoveRobot *robot, unsigned short address) {
+    if (robot->position < 0) return ROBOT_POSITION_UNKNOWN;
+    return abs(robot->position - (int) address);
+}
+
+static MoveRequest *scheduler_take(MoveSchedulerObject *self, MoveRobot *robot) {
+    MoveRequest *previous = NULL;
+    for (MoveRequest *request = self->pending; request != NULL; previous = request, request = request->next) {
+        int chosen = request->robot;
+        if (chosen < 0) {
+            int best = ROBOT_POSITION_UNKNOWN + 1;
+            for (int i = 0; i < self->robots_count; i++) {
+                MoveRobot *candidate = &self->robots[i];
+                int distance = robot_distance(candidate, request->source);
+                if (!candidate->busy && distance < best) {
+                    best = distance;
+                    chosen = i;
+                }
+            }
+        }
+        if (chosen != robot->index) {
+            continue;
+        }
+        if (previous != NULL) previous->next = request->next;
+        else self->pending = request->next;
+        if (self->pending_tail == request) self->pending_tail = previous;
+        self->queued--;
+        return request;
+    }
+    return NULL;
+}
+
+static void *robot_thread(void *arg) {
+    MoveRobot *robot = (MoveRobot *) arg;
+    MoveSchedulerObject *self = robot->scheduler;
+
+    pthread_mutex_lock(&self->lock);
+    for (;;) {
+        MoveRequest *request = scheduler_take(self, robot);
+        if (request == NULL) {
+            if (self->closing) {
+                break;
+            }
+            pthread_cond_wait(&self->cond, &self->lock);
+            continue;
+        }
+        robot->busy = 1;
+        self->in_flight++;
+        pthread_mutex_unlock(&self->lock);
+
+        struct move_medium move_medium;
+        move_medium.robot = robot->address;
+        move_medium.source = request->source;
+        move_medium.destination = request->destination;
+        move_medium.invert = 0;
+        uint64_t start = latency_now();
+        int error = dev_ioctl(self->fd, SMCIOC_MOVE_MEDIUM, &move_medium) ? errno : 0;
+        latency_record(LATENCY_MOVE, self->device->path, robot->address, request->destination, start);
+
+        pthread_mutex_lock(&self->lock);
+        request->robot_address = robot->address;
+        request->error = error;
+        robot->position = error ? -1 : request->destination;
+        robot->busy = 0;
+        self->in_flight--;
+        request_append(&self->done, &self->done_tail, request);
+        pthread_cond_broadcast(&self->cond);
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    return NULL;
+}
+
+/* Cancels queued requests and waits for the moves in flight, called without the GIL. */
+static void scheduler_stop(MoveSchedulerObject *self) {
+    pthread_mutex_lock(&self->lock);
+    self->closing = 1;
+    while (self->pending != NULL) {
+        MoveRequest *request = self->pending;
+        self->pending = request->next;
+        request->error = ECANCELED;
+        request_append(&self->done, &self->done_tail, request);
+    }
+    self->pending_tail = NULL;
+    self->queued = 0;
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+
+    for (int i = 0; i < self->robots_count; i++) {
+        if (self->robots[i].thread_started) {
+            pthread_join(self->robots[i].thread, NULL);
+            self->robots[i].thread_started = 0;
+        }
+    }
+
+    pthread_mutex_lock(&self->lock);
+    self->stopped = 1;
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+}
+
+static void scheduler_release(MoveSchedulerObject *self) {
+    if (self->device != NULL) {
+        changer_device_release(self->device);
+        Py_CLEAR(self->device);
+    }
+    self->fd = -1;
+}
+
+static int move_scheduler_init(MoveSchedulerObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"device", "robots", NULL};
+    ChangerDeviceObject *device;
+    PyObject *robots;
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "O!O", kwlist, &ChangerDeviceType, &device, &robots)) {
+        return -1;
+    }
+    if (self->robots != NULL) {
+        PyErr_SetString(PyExc_ValueError, "Scheduler is already open.");
+        return -1;
+    }
+
+    PyObject *sequence = PySequence_Fast(robots, "Robots have to be a sequence of addresses.");
+    if (sequence == NULL) {
+        return -1;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(sequence);
+    if (count <= 0) {
+        Py_DECREF(sequence);
+        PyErr_SetString(PyExc_ValueError, "At least one robot is required.");
+        return -1;
+    }
+    self->robots = calloc(count, sizeof(MoveRobot));
+    if (self->robots == NULL) {
+        Py_DECREF(sequence);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        unsigned long address = PyLong_AsUnsignedLong(PySequence_Fast_GET_ITEM(sequence, i));
+        if (PyErr_Occurred() || address > 0xFFFF) {
+            Py_DECREF(sequence);
+            if (!PyErr_Occurred()) PyErr_SetString(PyExc_ValueError, "Robot address is out of range.");
+            return -1;
+        }
+        self->robots[i].scheduler = self;
+        self->robots[i].index = (int) i;
+        self->robots[i].address = (unsigned short) address;
+        self->robots[i].position = -1;
+    }
+    Py_DECREF(sequence);
+    self->robots_count = (int) count;
+
+    int fd = changer_device_acquire(device);
+    if (fd < 0) {
+        return -1;
+    }
+    Py_INCREF(device);
+    self->device = device;
+    self->fd = fd;
+
+    for (int i = 0; i < self->robots_count; i++) {
+        if (pthread_create(&self->robots[i].thread, NULL, robot_thread, &self->robots[i])) {
+            Py_BEGIN_ALLOW_THREADS
+            scheduler_stop(self);
+            Py_END_ALLOW_THREADS
+            scheduler_release(self);
+            PyErr_SetString(PyExc_ValueError, "Failed to start robot thread.");
+            return -1;
+        }
+        self->robots[i].thread_started = 1;
+    }
+
+    return 0;
+}
+
+static PyObject *move_scheduler_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    MoveSchedulerObject *self = (MoveSchedulerObject *) type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->fd = -1;
+        self->next_id = 1;
+        pthread_mutex_init(&self->lock, NULL);
+        pthread_cond_init(&self->cond, NULL);
+    }
+    return (PyObject *) self;
+}
+
+static void move_scheduler_dealloc(MoveSchedulerObject *self) {
+    if (self->fd >= 0) {
+        Py_BEGIN_ALLOW_THREADS
+        scheduler_stop(self);
+        Py_END_ALLOW_THREADS
+    }
+    scheduler_release(self);
+    request_free_all(self->pending);
+    request_free_all(self->done);
+    free(self->robots);
+    pthread_cond_destroy(&self->cond);
+    pthread_mutex_destroy(&self->lock);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *method_submit(MoveSchedulerObject *self, PyObject *args) {
+    unsigned short source, destination;
+    PyObject *robot_address = Py_None;
+    if(!PyArg_ParseTuple(args, "HH|O", &source, &destination, &robot_address)) {
+        return NULL;
+    }
+
+    int robot = -1;
+    if (robot_address != Py_None) {
+        unsigned long address = PyLong_AsUnsignedLong(robot_address);
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+        for (int i = 0; i < self->robots_count; i++) {
+            if (self->robots[i].address == address) robot = i;
+        }
+        if (robot < 0) {
+            PyErr_SetString(PyExc_ValueError, "Robot is not handled by the scheduler.");
+            return NULL;
+        }
+    }
+
+    MoveRequest *request = calloc(1, sizeof(MoveRequest));
+    if (request == NULL) {
+        return PyErr_NoMemory();
+    }
+    request->source = source;
+    request->destination = destination;
+    request->robot = robot;
+
+    pthread_mutex_lock(&self->lock);
+    if (self->closing) {
+        pthread_mutex_unlock(&self->lock);
+        free(request);
+        PyErr_SetString(PyExc_ValueError, "Scheduler is closed.");
+        return NULL;
+    }
+    request->id = self->next_id++;
+    request_append(&self->pending, &self->pending_tail, request);
+    self->queued++;
+    unsigned long long id = request->id;
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+
+    return PyLong_FromUnsignedLongLong(id);
+}
+
+/* Waits for finished moves with the lock held, timeout below zero waits forever. */
+static MoveRequest *scheduler_wait(MoveSchedulerObject *self, double timeout) {
+    struct timespec deadline;
+    if (timeout >= 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += (time_t) timeout;
+        deadline.tv_nsec += (long) ((timeout - (time_t) timeout) * 1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&self->lock);
+    while (self->done == NULL && !self->stopped) {
+        if (timeout < 0) {
+            pthread_cond_wait(&self->cond, &self->lock);
+        } else if (pthread_cond_timedwait(&self->cond, &self->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    MoveRequest *done = self->done;
+    self->done = NULL;
+    self->done_tail = NULL;
+    pthread_mutex_unlock(&self->lock);
+
+    return done;
+}
+
+static PyObject *method_wait(MoveSchedulerObject *self, PyObject *args) {
+    PyObject *timeout_object = Py_None;
+    if(!PyArg_ParseTuple(args, "|O", &timeout_object)) {
+        return NULL;
+    }
+    double timeout = -1;
+    if (timeout_object != Py_None) {
+        timeout = PyFloat_AsDouble(timeout_object);
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+        if (timeout < 0) timeout = 0;
+    }
+
+    MoveRequest *done;
+    int stopped;
+    Py_BEGIN_ALLOW_THREADS
+    done = scheduler_wait(self, timeout);
+    stopped = self->stopped;
+    Py_END_ALLOW_THREADS
+    if (done == NULL && stopped) {
+        Py_RETURN_NONE;
+    }
+
+    PyObject *list = PyList_New(0);
+    for (MoveRequest *request = done; request != NULL && list != NULL; request = request->next) {
+        PyObject *item = Py_BuildValue("(KHHHi)", request->id, request->source, request->destination, request->robot_address, request->error);
+        if (item == NULL || PyList_Append(list, item) < 0) {
+            Py_CLEAR(list);
+        }
+        Py_XDECREF(item);
+    }
+    request_free_all(done);
+
+    return list;
+}
+
+static PyObject *method_scheduler_close(MoveSchedulerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->fd < 0) {
+        Py_RETURN_NONE;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    scheduler_stop(self);
+    Py_END_ALLOW_THREADS
+    scheduler_release(self);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *method_scheduler_enter(MoveSchedulerObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->fd < 0) {
+        PyErr_SetString(PyExc_ValueError, "Scheduler is closed.");
+        return NULL;
+    }
+
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
+static PyObject *method_scheduler_exit(MoveSchedulerObject *self, PyObject *args) {
+    return method_scheduler_close(self, NULL);
+}
+
+static PyObject *move_scheduler_get_closed(MoveSchedulerObject *self, void *closure) {
+    return PyBool_FromLong(self->fd < 0);
+}
+
+static PyObject *move_scheduler_get_pending(MoveSchedulerObject *self, void *closure) {
+    pthread_mutex_lock(&self->lock);
+    int pending = self->queued + self->in_flight;
+    pthread_mutex_unlock(&self->lock);
+    return PyLong_FromLong(pending);
+}
+
+static PyObject *move_scheduler_get_robots(MoveSchedulerObject *self, void *closure) {
+    PyObject *robots = PyTuple_New(self->robots_count);
+    for (int i = 0; robots != NULL && i < self->robots_count; i++) {
+        PyTuple_SET_ITEM(robots, i, PyLong_FromLong(self->robots[i].address));
+    }
+    return robots;
+}
+
+static PyMethodDef move_scheduler_methods[] = {
+    {"submit", (PyCFunction) method_submit, METH_VARARGS, "Queue a move and return its id, optionally for the given robot"},
+    {"wait", (PyCFunction) method_wait, METH_VARARGS, "Wait for finished moves, returns tuples (id, source, destination, robot, errno) or None once closed"},
+    {"close", (PyCFunction) method_scheduler_close, METH_NOARGS, "Cancel queued moves and wait for the ones in progress"},
+    {"__enter__", (PyCFunction) method_scheduler_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction) method_scheduler_exit, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef move_scheduler_getset[] = {
+    {"closed", (getter) move_scheduler_get_closed, NULL, "True if the scheduler is closed", NULL},
+    {"pending", (getter) move_scheduler_get_pending, NULL, "Number of queued and running moves", NULL},
+    {"robots", (getter) move_scheduler_get_robots, NULL, "Addresses of the robots used by the scheduler", NULL},
+    {NULL}
+};
+
+PyTypeObject MoveSchedulerType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.changer.MoveScheduler",
+    .tp_doc = "Queue of moves dispatched in parallel over the robots of the library",
+    .tp_basicsize = sizeof(MoveSchedulerObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = move_scheduler_new,
+    .tp_init = (initproc) move_scheduler_init,
+    .tp_dealloc = (destructor) move_scheduler_dealloc,
+    .tp_methods = move_scheduler_methods,
+    .tp_getset = move_scheduler_getset,
+};
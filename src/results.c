@@ -0,0 +1,473 @@
+#include <Python.h>
+#include <structmember.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <linux/version.h>
+#include "IBM_tape.h"
+#include "tape.h"
+
+
+/* Results of the queries keep the raw ioctl struct, fields are decoded only when
+ * read. Attribute access is the fast path, indexing by the field name is kept so
+ * code written for the former dicts still works. */
+typedef struct {
+    PyObject_HEAD
+    struct stchgp_s query;
+} TapeParamsObject;
+
+typedef struct {
+    PyObject_HEAD
+    struct stpos_s query;
+} TapePositionObject;
+
+typedef struct {
+    PyObject_HEAD
+    struct query_partition query;
+} TapePartitionsObject;
+
+typedef struct {
+    PyObject_HEAD
+    struct long_data_format data;
+} TapeLongPositionObject;
+
+typedef struct {
+    PyObject_HEAD
+    struct short_data_format data;
+} TapeShortPositionObject;
+
+typedef struct {
+    PyObject_HEAD
+    struct extended_data_format data;
+} TapeExtendedPositionObject;
+
+/* UDS descriptor of a RECEIVE RAO list, the part without geometry */
+typedef struct {
+    PyObject_HEAD
+    unsigned char desc[RAO_UDS_DESC_LEN];
+} TapeRaoDescriptorObject;
+
+static PyObject *result_subscript(PyObject *self, PyObject *key) {
+    if (!PyUnicode_Check(key)) {
+        PyErr_SetObject(PyExc_KeyError, key);
+        return NULL;
+    }
+    PyObject *value = PyObject_GetAttr(self, key);
+    if (value == NULL && PyErr_ExceptionMatches(PyExc_AttributeError)) {
+        PyErr_Clear();
+        PyErr_SetObject(PyExc_KeyError, key);
+    }
+    return value;
+}
+
+static int result_repr_field(PyObject *self, PyObject *parts, const char *name) {
+    PyObject *value = PyObject_GetAttrString(self, name);
+    if (value == NULL) {
+        return -1;
+    }
+    PyObject *part = PyUnicode_FromFormat("%s=%R", name, value);
+    Py_DECREF(value);
+    if (part == NULL) {
+        return -1;
+    }
+    int ret = PyList_Append(parts, part);
+    Py_DECREF(part);
+    return ret;
+}
+
+/* Lists the members and then the computed fields of the type */
+static PyObject *result_repr(PyObject *self) {
+    PyTypeObject *type = Py_TYPE(self);
+    PyObject *parts = PyList_New(0);
+    if (parts == NULL) {
+        return NULL;
+    }
+    for (PyMemberDef *member = type->tp_members; member != NULL && member->name != NULL; member++) {
+        if (result_repr_field(self, parts, member->name)) {
+            Py_DECREF(parts);
+            return NULL;
+        }
+    }
+    for (PyGetSetDef *getset = type->tp_getset; getset != NULL && getset->name != NULL; getset++) {
+        if (result_repr_field(self, parts, getset->name)) {
+            Py_DECREF(parts);
+            return NULL;
+        }
+    }
+    PyObject *separator = PyUnicode_FromString(", ");
+    PyObject *fields = separator != NULL ? PyUnicode_Join(separator, parts) : NULL;
+    Py_XDECREF(separator);
+    Py_DECREF(parts);
+    if (fields == NULL) {
+        return NULL;
+    }
+    const char *name = strrchr(type->tp_name, '.');
+    PyObject *output = PyUnicode_FromFormat("%s(%U)", name != NULL ? name + 1 : type->tp_name, fields);
+    Py_DECREF(fields);
+    return output;
+}
+
+static PyMappingMethods result_as_mapping = {
+    .mp_subscript = result_subscript,
+};
+
+#define PARAMS_MEMBER(name, type) {#name, type, offsetof(TapeParamsObject, query.name), READONLY, NULL}
+
+static PyMemberDef tape_params_members[] = {
+    PARAMS_MEMBER(autoload, T_BOOL),
+    PARAMS_MEMBER(buffered_mode, T_BOOL),
+    PARAMS_MEMBER(compression, T_BOOL),
+    PARAMS_MEMBER(trailer_labels, T_BOOL),
+    PARAMS_MEMBER(rewind_immediate, T_BOOL),
+    PARAMS_MEMBER(bus_domination, T_BOOL),
+    PARAMS_MEMBER(logging, T_BOOL),
+    PARAMS_MEMBER(write_protect, T_BOOL),
+    PARAMS_MEMBER(emulate_autoloader, T_BOOL),
+    PARAMS_MEMBER(wfm_immediate, T_BOOL),
+    PARAMS_MEMBER(limit_read_recov, T_BOOL),
+    PARAMS_MEMBER(limit_write_recov, T_BOOL),
+    PARAMS_MEMBER(data_safe_mode, T_BOOL),
+    PARAMS_MEMBER(disable_sim_logging, T_BOOL),
+    PARAMS_MEMBER(read_sili_bit, T_BOOL),
+    PARAMS_MEMBER(disable_auto_drive_dump, T_BOOL),
+    PARAMS_MEMBER(trace, T_BOOL),
+    PARAMS_MEMBER(acf_mode, T_UBYTE),
+    PARAMS_MEMBER(record_space_mode, T_UBYTE),
+    PARAMS_MEMBER(logical_write_protect, T_UBYTE),
+    PARAMS_MEMBER(capacity_scaling, T_UBYTE),
+    PARAMS_MEMBER(retain_reservation, T_UBYTE),
+    PARAMS_MEMBER(alt_pathing, T_UBYTE),
+    PARAMS_MEMBER(medium_type, T_UBYTE),
+    PARAMS_MEMBER(density_code, T_UBYTE),
+    PARAMS_MEMBER(read_past_filemark, T_UBYTE),
+    PARAMS_MEMBER(capacity_scaling_value, T_UBYTE),
+    PARAMS_MEMBER(busy_retry, T_UBYTE),
+    PARAMS_MEMBER(reserve_type, T_UBYTE),
+    PARAMS_MEMBER(hkwrd, T_UINT),
+    PARAMS_MEMBER(min_blksize, T_UINT),
+    PARAMS_MEMBER(max_blksize, T_UINT),
+    PARAMS_MEMBER(max_scsi_xfer, T_UINT),
+    PARAMS_MEMBER(blksize, T_INT),
+    {NULL}
+};
+
+static PyObject *tape_params_get_volid(TapeParamsObject *self, void *closure) {
+    return PyUnicode_FromStringAndSize(self->query.volid, sizeof(self->query.volid));
+}
+
+static PyGetSetDef tape_params_getset[] = {
+    {"volid", (getter) tape_params_get_volid, NULL, "Volume id of the cartridge", NULL},
+    {NULL}
+};
+
+PyTypeObject TapeParamsType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.tape.TapeParams",
+    .tp_doc = "Parameters of the drive, decoded on access",
+    .tp_basicsize = sizeof(TapeParamsObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_repr = result_repr,
+    .tp_as_mapping = &result_as_mapping,
+    .tp_members = tape_params_members,
+    .tp_getset = tape_params_getset,
+};
+
+#define POSITION_MEMBER(name, type) {#name, type, offsetof(TapePositionObject, query.name), READONLY, NULL}
+
+static PyMemberDef tape_position_members[] = {
+    POSITION_MEMBER(eot, T_BOOL),
+    POSITION_MEMBER(bot, T_BOOL),
+    POSITION_MEMBER(tapepos, T_UINT),
+    POSITION_MEMBER(curpos, T_UINT),
+    POSITION_MEMBER(lbot, T_UINT),
+    POSITION_MEMBER(num_blocks, T_UINT),
+    POSITION_MEMBER(block_type, T_UBYTE),
+    POSITION_MEMBER(partition_number, T_UBYTE),
+    {NULL}
+};
+
+PyTypeObject TapePositionType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.tape.TapePosition",
+    .tp_doc = "Position of the tape, decoded on access",
+    .tp_basicsize = sizeof(TapePositionObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_repr = result_repr,
+    .tp_as_mapping = &result_as_mapping,
+    .tp_members = tape_position_members,
+};
+
+#define PARTITIONS_MEMBER(name) {#name, T_UBYTE, offsetof(TapePartitionsObject, query.name), READONLY, NULL}
+
+static PyMemberDef tape_partitions_members[] = {
+    PARTITIONS_MEMBER(max_partitions),
+    PARTITIONS_MEMBER(active_partition),
+    PARTITIONS_MEMBER(number_of_partitions),
+    PARTITIONS_MEMBER(size_unit),
+    PARTITIONS_MEMBER(partition_method),
+    {NULL}
+};
+
+static PyObject *tape_partitions_get_size(TapePartitionsObject *self, void *closure) {
+    PyObject *output = PyList_New(MAX_PARTITIONS);
+    if (output == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < MAX_PARTITIONS; i++) {
+        PyObject *size = PyLong_FromLong(self->query.size[i]);
+        if (size == NULL) {
+            Py_DECREF(output);
+            return NULL;
+        }
+        PyList_SET_ITEM(output, i, size);
+    }
+    return output;
+}
+
+static PyGetSetDef tape_partitions_getset[] = {
+    {"size", (getter) tape_partitions_get_size, NULL, "Sizes of all partitions in size units", NULL},
+    {NULL}
+};
+
+PyTypeObject TapePartitionsType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.tape.TapePartitions",
+    .tp_doc = "Partitions of the tape, decoded on access",
+    .tp_basicsize = sizeof(TapePartitionsObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_repr = result_repr,
+    .tp_as_mapping = &result_as_mapping,
+    .tp_members = tape_partitions_members,
+    .tp_getset = tape_partitions_getset,
+};
+
+static PyMemberDef tape_long_position_members[] = {
+    {"active_partition", T_UBYTE, offsetof(TapeLongPositionObject, data.active_partition), READONLY, NULL},
+    {NULL}
+};
+
+/* Flags are bit fields, so they cannot be members */
+#define LONG_POSITION_FLAG(name) \
+    static PyObject *tape_long_position_get_##name(TapeLongPositionObject *self, void *closure) { \
+        return PyBool_FromLong(self->data.name); \
+    }
+
+LONG_POSITION_FLAG(bop)
+LONG_POSITION_FLAG(eop)
+LONG_POSITION_FLAG(bpew)
+LONG_POSITION_FLAG(mpu)
+LONG_POSITION_FLAG(lonu)
+
+static PyObject *tape_long_position_get_logical_obj_number(TapeLongPositionObject *self, void *closure) {
+    return PyLong_FromUnsignedLongLong(get_be(self->data.logical_obj_number, sizeof(self->data.logical_obj_number)));
+}
+
+static PyObject *tape_long_position_get_logical_file_id(TapeLongPositionObject *self, void *closure) {
+    return PyLong_FromUnsignedLongLong(get_be(self->data.logical_file_id, sizeof(self->data.logical_file_id)));
+}
+
+/* Declared obsolete by SSC-4, drives which still report it give the logical set */
+static PyObject *tape_long_position_get_logical_set_id(TapeLongPositionObject *self, void *closure) {
+    return PyLong_FromUnsignedLongLong(get_be(self->data.obsolete, sizeof(self->data.obsolete)));
+}
+
+static PyGetSetDef tape_long_position_getset[] = {
+    {"bop", (getter) tape_long_position_get_bop, NULL, "Beginning of the partition", NULL},
+    {"eop", (getter) tape_long_position_get_eop, NULL, "End of the partition", NULL},
+    {"bpew", (getter) tape_long_position_get_bpew, NULL, "Beyond the programmable early warning", NULL},
+    {"mpu", (getter) tape_long_position_get_mpu, NULL, "Mark position unknown", NULL},
+    {"lonu", (getter) tape_long_position_get_lonu, NULL, "Logical object number unknown", NULL},
+    {"logical_obj_number", (getter) tape_long_position_get_logical_obj_number, NULL, "Logical object at the position", NULL},
+    {"logical_file_id", (getter) tape_long_position_get_logical_file_id, NULL, "Number of filemarks before the position", NULL},
+    {"logical_set_id", (getter) tape_long_position_get_logical_set_id, NULL, "Logical set at the position, 0 if not reported", NULL},
+    {NULL}
+};
+
+PyTypeObject TapeLongPositionType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.tape.TapeLongPosition",
+    .tp_doc = "Long form of the tape position, decoded on access",
+    .tp_basicsize = sizeof(TapeLongPositionObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_repr = result_repr,
+    .tp_as_mapping = &result_as_mapping,
+    .tp_members = tape_long_position_members,
+    .tp_getset = tape_long_position_getset,
+};
+
+/* Short and extended forms share the flags and the buffer counters */
+#define POSITION_FLAG(prefix, type, name) \
+    static PyObject *prefix##_get_##name(type *self, void *closure) { \
+        return PyBool_FromLong(self->data.name); \
+    }
+
+#define POSITION_NUMBER(prefix, type, name) \
+    static PyObject *prefix##_get_##name(type *self, void *closure) { \
+        return PyLong_FromUnsignedLongLong(get_be(self->data.name, sizeof(self->data.name))); \
+    }
+
+#define POSITION_GETSET(prefix, name, doc) {#name, (getter) prefix##_get_##name, NULL, doc, NULL}
+
+#define POSITION_FORM(prefix, type) \
+    POSITION_FLAG(prefix, type, bop) \
+    POSITION_FLAG(prefix, type, eop) \
+    POSITION_FLAG(prefix, type, bpew) \
+    POSITION_FLAG(prefix, type, perr) \
+    POSITION_FLAG(prefix, type, lolu) \
+    POSITION_FLAG(prefix, type, bycu) \
+    POSITION_FLAG(prefix, type, locu) \
+    POSITION_NUMBER(prefix, type, first_logical_obj_position) \
+    POSITION_NUMBER(prefix, type, last_logical_obj_position) \
+    POSITION_NUMBER(prefix, type, num_buffer_logical_obj) \
+    POSITION_NUMBER(prefix, type, num_buffer_bytes)
+
+#define POSITION_FORM_GETSET(prefix) \
+    POSITION_GETSET(prefix, bop, "Beginning of the partition"), \
+    POSITION_GETSET(prefix, eop, "End of the partition"), \
+    POSITION_GETSET(prefix, bpew, "Beyond the programmable early warning"), \
+    POSITION_GETSET(prefix, perr, "Position counters overflowed"), \
+    POSITION_GETSET(prefix, lolu, "Last logical object position unknown"), \
+    POSITION_GETSET(prefix, bycu, "Byte count of the buffer unknown"), \
+    POSITION_GETSET(prefix, locu, "Logical object count of the buffer unknown"), \
+    POSITION_GETSET(prefix, first_logical_obj_position, "Next logical object to be transferred to or from the host"), \
+    POSITION_GETSET(prefix, last_logical_obj_position, "Next logical object to be transferred to or from the medium"), \
+    POSITION_GETSET(prefix, num_buffer_logical_obj, "Logical objects in the buffer of the drive"), \
+    POSITION_GETSET(prefix, num_buffer_bytes, "Bytes in the buffer of the drive")
+
+POSITION_FORM(tape_short_position, TapeShortPositionObject)
+POSITION_FORM(tape_extended_position, TapeExtendedPositionObject)
+POSITION_NUMBER(tape_extended_position, TapeExtendedPositionObject, additional_length)
+
+static PyMemberDef tape_short_position_members[] = {
+    {"active_partition", T_UBYTE, offsetof(TapeShortPositionObject, data.active_partition), READONLY, NULL},
+    {NULL}
+};
+
+static PyGetSetDef tape_short_position_getset[] = {
+    POSITION_FORM_GETSET(tape_short_position),
+    {NULL}
+};
+
+PyTypeObject TapeShortPositionType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.tape.TapeShortPosition",
+    .tp_doc = "Short form of the tape position with 32 bit counters, decoded on access",
+    .tp_basicsize = sizeof(TapeShortPositionObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_repr = result_repr,
+    .tp_as_mapping = &result_as_mapping,
+    .tp_members = tape_short_position_members,
+    .tp_getset = tape_short_position_getset,
+};
+
+static PyMemberDef tape_extended_position_members[] = {
+    {"active_partition", T_UBYTE, offsetof(TapeExtendedPositionObject, data.active_partition), READONLY, NULL},
+    {NULL}
+};
+
+static PyGetSetDef tape_extended_position_getset[] = {
+    POSITION_FORM_GETSET(tape_extended_position),
+    POSITION_GETSET(tape_extended_position, additional_length, "Length of the data after the header"),
+    {NULL}
+};
+
+PyTypeObject TapeExtendedPositionType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.tape.TapeExtendedPosition",
+    .tp_doc = "Extended form of the tape position with 64 bit counters, decoded on access",
+    .tp_basicsize = sizeof(TapeExtendedPositionObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_repr = result_repr,
+    .tp_as_mapping = &result_as_mapping,
+    .tp_members = tape_extended_position_members,
+    .tp_getset = tape_extended_position_getset,
+};
+
+/* The UDS name is the index of the extent in the generated list, in decimal */
+static PyObject *tape_rao_descriptor_get_index(TapeRaoDescriptorObject *self, void *closure) {
+    char name[RAO_UDS_NAME_LEN + 1];
+    memcpy(name, self->desc + 5, RAO_UDS_NAME_LEN);
+    name[RAO_UDS_NAME_LEN] = '\0';
+    return PyLong_FromLong(strtol(name, NULL, 10));
+}
+
+static PyObject *tape_rao_descriptor_get_start_block(TapeRaoDescriptorObject *self, void *closure) {
+    return PyLong_FromUnsignedLongLong(get_be(self->desc + 16, 8));
+}
+
+static PyObject *tape_rao_descriptor_get_end_block(TapeRaoDescriptorObject *self, void *closure) {
+    return PyLong_FromUnsignedLongLong(get_be(self->desc + 24, 8));
+}
+
+static PyMemberDef tape_rao_descriptor_members[] = {
+    {"partition", T_UBYTE, offsetof(TapeRaoDescriptorObject, desc) + 15, READONLY, NULL},
+    {NULL}
+};
+
+static PyGetSetDef tape_rao_descriptor_getset[] = {
+    {"index", (getter) tape_rao_descriptor_get_index, NULL, "Index of the extent in the generated list", NULL},
+    {"start_block", (getter) tape_rao_descriptor_get_start_block, NULL, "First logical object of the extent", NULL},
+    {"end_block", (getter) tape_rao_descriptor_get_end_block, NULL, "Last logical object of the extent", NULL},
+    {NULL}
+};
+
+PyTypeObject TapeRaoDescriptorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.tape.TapeRaoDescriptor",
+    .tp_doc = "Extent of the recommended access order, decoded on access",
+    .tp_basicsize = sizeof(TapeRaoDescriptorObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_repr = result_repr,
+    .tp_as_mapping = &result_as_mapping,
+    .tp_members = tape_rao_descriptor_members,
+    .tp_getset = tape_rao_descriptor_getset,
+};
+
+PyObject *tape_params_from(const struct stchgp_s *query) {
+    TapeParamsObject *self = PyObject_New(TapeParamsObject, &TapeParamsType);
+    if (self != NULL) self->query = *query;
+    return (PyObject *) self;
+}
+
+PyObject *tape_position_from(const struct stpos_s *query) {
+    TapePositionObject *self = PyObject_New(TapePositionObject, &TapePositionType);
+    if (self != NULL) self->query = *query;
+    return (PyObject *) self;
+}
+
+PyObject *tape_partitions_from(const struct query_partition *query) {
+    TapePartitionsObject *self = PyObject_New(TapePartitionsObject, &TapePartitionsType);
+    if (self != NULL) self->query = *query;
+    return (PyObject *) self;
+}
+
+PyObject *tape_long_position_from(const struct long_data_format *data) {
+    TapeLongPositionObject *self = PyObject_New(TapeLongPositionObject, &TapeLongPositionType);
+    if (self != NULL) self->data = *data;
+    return (PyObject *) self;
+}
+
+PyObject *tape_short_position_from(const struct short_data_format *data) {
+    TapeShortPositionObject *self = PyObject_New(TapeShortPositionObject, &TapeShortPositionType);
+    if (self != NULL) self->data = *data;
+    return (PyObject *) self;
+}
+
+PyObject *tape_extended_position_from(const struct extended_data_format *data) {
+    TapeExtendedPositionObject *self = PyObject_New(TapeExtendedPositionObject, &TapeExtendedPositionType);
+    if (self != NULL) self->data = *data;
+    return (PyObject *) self;
+}
+
+PyObject *tape_rao_descriptor_from(const unsigned char *desc) {
+    TapeRaoDescriptorObject *self = PyObject_New(TapeRaoDescriptorObject, &TapeRaoDescriptorType);
+    if (self != NULL) memcpy(self->desc, desc, RAO_UDS_DESC_LEN);
+    return (PyObject *) self;
+}
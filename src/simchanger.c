@@ -0,0 +1,467 @@
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <linux/version.h>
+#include "IBM_tape.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "device.h"
+
+#define SIM_BARCODE_LEN 36
+#define SIM_SERIAL_LEN 24
+
+
+enum sim_element_type {SIM_ROBOT, SIM_SLOT, SIM_DRIVE, SIM_IE_STATION, SIM_TYPES};
+
+static const char *sim_element_names[SIM_TYPES] = {"robot", "slot", "drive", "ie"};
+
+typedef struct {
+    int type;
+    unsigned short address;
+    unsigned short source;
+    char barcode[SIM_BARCODE_LEN + 1];
+    char serial[SIM_SERIAL_LEN + 1];
+    /* Robots only: last element visited and whether a move is in progress */
+    unsigned short position;
+    int busy;
+} SimElement;
+
+/* The library is a text file with one element per line, "<type> <address>" and
+ * optional "barcode=", "source=" and "serial=" fields, type is one of robot,
+ * slot, drive or ie. "move_time" and "move_element_time" lines set the timing
+ * model. The file is rewritten after every move, so the state survives. */
+typedef struct SimChanger {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    char *file;
+    /* Handles of the same file share the library, like several hosts of one library */
+    int refs;
+    struct SimChanger *next;
+    SimElement *elements;
+    int count;
+    double move_time;
+    double move_element_time;
+} SimChanger;
+
+static pthread_mutex_t sim_changers_lock = PTHREAD_MUTEX_INITIALIZER;
+static SimChanger *sim_changers = NULL;
+
+static int sim_element_compare(const void *first, const void *second) {
+    const SimElement *a = first, *b = second;
+    if (a->type != b->type) return a->type - b->type;
+    return (int) a->address - (int) b->address;
+}
+
+static SimElement *sim_element_find(SimChanger *self, unsigned short address) {
+    for (int i = 0; i < self->count; i++) {
+        if (self->elements[i].address == address) return &self->elements[i];
+    }
+    return NULL;
+}
+
+static int sim_changer_load(SimChanger *self) {
+    FILE *file = fopen(self->file, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    char line[512];
+    int capacity = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char name[32];
+        double value;
+        unsigned int address;
+        int consumed = 0;
+        if (sscanf(line, "%31s %lf", name, &value) == 2 && !strcmp(name, "move_time")) {
+            self->move_time = value;
+            continue;
+        }
+        if (sscanf(line, "%31s %lf", name, &value) == 2 && !strcmp(name, "move_element_time")) {
+            self->move_element_time = value;
+            continue;
+        }
+        if (sscanf(line, "%31s %u%n", name, &address, &consumed) != 2) {
+            continue;
+        }
+        int type = -1;
+        for (int i = 0; i < SIM_TYPES; i++) {
+            if (!strcmp(name, sim_element_names[i])) type = i;
+        }
+        if (type < 0) {
+            continue;
+        }
+        if (self->count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            SimElement *elements = realloc(self->elements, capacity * sizeof(SimElement));
+            if (elements == NULL) {
+                fclose(file);
+                errno = ENOMEM;
+                return -1;
+            }
+            self->elements = elements;
+        }
+        SimElement *element = &self->elements[self->count++];
+        memset(element, 0, sizeof(SimElement));
+        element->type = type;
+        element->address = (unsigned short) address;
+        element->position = element->address;
+
+        char field[128];
+        const char *rest = line + consumed;
+        int length;
+        while (sscanf(rest, "%127s%n", field, &length) == 1) {
+            rest += length;
+            if (!strncmp(field, "barcode=", 8)) snprintf(element->barcode, sizeof(element->barcode), "%.36s", field + 8);
+            else if (!strncmp(field, "source=", 7)) element->source = (unsigned short) strtoul(field + 7, NULL, 0);
+            else if (!strncmp(field, "serial=", 7)) snprintf(element->serial, sizeof(element->serial), "%.24s", field + 7);
+        }
+    }
+    fclose(file);
+    qsort(self->elements, self->count, sizeof(SimElement), sim_element_compare);
+    return 0;
+}
+
+/* Called with the lock held, written to a temporary file first so readers never see half of it */
+static int sim_changer_save(SimChanger *self) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.tmp", self->file);
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    fprintf(file, "move_time %g\nmove_element_time %g\n", self->move_time, self->move_element_time);
+    for (int i = 0; i < self->count; i++) {
+        SimElement *element = &self->elements[i];
+        fprintf(file, "%s %u", sim_element_names[element->type], element->address);
+        if (element->barcode[0]) fprintf(file, " barcode=%s", element->barcode);
+        if (element->barcode[0] && element->source) fprintf(file, " source=%u", element->source);
+        if (element->serial[0]) fprintf(file, " serial=%s", element->serial);
+        fprintf(file, "\n");
+    }
+    if (fclose(file)) {
+        return -1;
+    }
+    return rename(path, self->file);
+}
+
+static void sim_element_status(SimElement *element, struct element_status *status) {
+    memset(status, 0, sizeof(*status));
+    status->address = element->address;
+    status->full = element->barcode[0] != '\0';
+    status->access = element->type != SIM_ROBOT;
+    status->svalid = status->full && element->source != 0;
+    status->source = status->svalid ? element->source : 0;
+    memset(status->volume, ' ', sizeof(status->volume));
+    memcpy(status->volume, element->barcode, strlen(element->barcode));
+}
+
+static double sim_travel_cost(SimChanger *self, unsigned short from, unsigned short to) {
+    return self->move_element_time * (from > to ? from - to : to - from);
+}
+
+/* Waits until the robot is free and marks it busy, called with the lock held */
+static SimElement *sim_robot_take(SimChanger *self, unsigned short address) {
+    SimElement *robot = sim_element_find(self, address);
+    if (robot == NULL || robot->type != SIM_ROBOT) {
+        errno = EINVAL;
+        return NULL;
+    }
+    while (robot->busy) pthread_cond_wait(&self->cond, &self->lock);
+    robot->busy = 1;
+    return robot;
+}
+
+static void sim_robot_give_back(SimChanger *self, SimElement *robot, unsigned short position) {
+    pthread_mutex_lock(&self->lock);
+    robot->busy = 0;
+    robot->position = position;
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+}
+
+static void sim_place(SimElement *destination, SimElement *source) {
+    snprintf(destination->barcode, sizeof(destination->barcode), "%s", source->barcode);
+    int from_storage = source->type == SIM_SLOT || source->type == SIM_IE_STATION;
+    destination->source = from_storage ? source->address : source->source;
+}
+
+static void sim_clear(SimElement *element) {
+    element->barcode[0] = '\0';
+    element->source = 0;
+}
+
+/* The state changes at the start of the move, the robot is busy until its travel time passed */
+static int sim_move(SimChanger *self, struct move_medium *query) {
+    pthread_mutex_lock(&self->lock);
+    SimElement *robot = sim_robot_take(self, query->robot);
+    if (robot == NULL) {
+        pthread_mutex_unlock(&self->lock);
+        return -1;
+    }
+    SimElement *source = sim_element_find(self, query->source);
+    SimElement *destination = sim_element_find(self, query->destination);
+    int error = 0;
+    if (source == NULL || destination == NULL || source->type == SIM_ROBOT || destination->type == SIM_ROBOT) error = EINVAL;
+    else if (!source->barcode[0] || (destination != source && destination->barcode[0])) error = EIO;
+    double cost = 0;
+    if (!error && destination != source) {
+        cost = self->move_time + sim_travel_cost(self, robot->position, source->address) + sim_travel_cost(self, source->address, destination->address);
+        sim_place(destination, source);
+        sim_clear(source);
+        if (sim_changer_save(self)) error = errno;
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    sim_sleep(cost);
+    sim_robot_give_back(self, robot, error ? robot->position : query->destination);
+    if (error) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+static int sim_exchange(SimChanger *self, struct exchange_medium *query) {
+    pthread_mutex_lock(&self->lock);
+    SimElement *robot = sim_robot_take(self, query->robot);
+    if (robot == NULL) {
+        pthread_mutex_unlock(&self->lock);
+        return -1;
+    }
+    SimElement *source = sim_element_find(self, query->source);
+    SimElement *first = sim_element_find(self, query->destination1);
+    SimElement *second = sim_element_find(self, query->destination2);
+    int error = 0;
+    if (source == NULL || first == NULL || second == NULL || source == first) error = EINVAL;
+    else if (!source->barcode[0] || !first->barcode[0] || (second != source && second->barcode[0])) error = EIO;
+    double cost = 0;
+    if (!error) {
+        cost = 2 * self->move_time + sim_travel_cost(self, robot->position, source->address) + sim_travel_cost(self, source->address, first->address) + sim_travel_cost(self, first->address, second->address);
+        SimElement moved_source = *source, moved_first = *first;
+        sim_clear(source);
+        sim_place(first, &moved_source);
+        sim_place(second, &moved_first);
+        if (sim_changer_save(self)) error = errno;
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    sim_sleep(cost);
+    sim_robot_give_back(self, robot, error ? robot->position : query->destination2);
+    if (error) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+static int sim_position(SimChanger *self, struct pos_to_elem *query) {
+    pthread_mutex_lock(&self->lock);
+    SimElement *robot = sim_robot_take(self, query->robot);
+    if (robot == NULL) {
+        pthread_mutex_unlock(&self->lock);
+        return -1;
+    }
+    SimElement *destination = sim_element_find(self, query->destination);
+    double cost = destination == NULL ? 0 : sim_travel_cost(self, robot->position, destination->address);
+    pthread_mutex_unlock(&self->lock);
+
+    sim_sleep(cost);
+    sim_robot_give_back(self, robot, destination == NULL ? robot->position : destination->address);
+    if (destination == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static void sim_type_range(SimChanger *self, int type, ushort *first, ushort *count) {
+    *first = 0;
+    *count = 0;
+    for (int i = 0; i < self->count; i++) {
+        if (self->elements[i].type != type) continue;
+        if (*count == 0) *first = self->elements[i].address;
+        (*count)++;
+    }
+}
+
+static void sim_inventory(SimChanger *self, struct inventory *query) {
+    struct element_status *targets[SIM_TYPES] = {query->robot_status, query->slot_status, query->drive_status, query->ie_status};
+    int written[SIM_TYPES] = {0};
+    for (int i = 0; i < self->count; i++) {
+        SimElement *element = &self->elements[i];
+        if (targets[element->type] != NULL) sim_element_status(element, &targets[element->type][written[element->type]++]);
+    }
+}
+
+/* Elements from the first address on in address order, like the library reports them */
+static int sim_elements_from(SimChanger *self, unsigned short first, int type, SimElement **output, int count) {
+    int found = 0;
+    for (int address = first; address <= 0xFFFF && found < count; address++) {
+        SimElement *element = sim_element_find(self, (unsigned short) address);
+        if (element != NULL && (type < 0 || element->type == type)) output[found++] = element;
+    }
+    return found;
+}
+
+static int sim_read_devids(SimChanger *self, struct read_element_devids *query) {
+    SimElement **elements = calloc(query->number_elements > 0 ? query->number_elements : 1, sizeof(SimElement *));
+    if (elements == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    int found = sim_elements_from(self, query->element_address, SIM_DRIVE, elements, query->number_elements);
+    for (int i = 0; i < found; i++) {
+        struct element_devid *devid = &query->drive_devid[i];
+        memset(devid, 0, sizeof(*devid));
+        devid->address = elements[i]->address;
+        devid->full = elements[i]->barcode[0] != '\0';
+        devid->access = 1;
+        devid->code_set = 2;
+        devid->ident_type = 1;
+        int length = snprintf((char *) devid->identifier, sizeof(devid->identifier), "IBM     ULT3580-SIM     %s", elements[i]->serial);
+        devid->ident_len = length < (int) sizeof(devid->identifier) ? length : (int) sizeof(devid->identifier);
+    }
+    free(elements);
+    return 0;
+}
+
+static int sim_read_locations(SimChanger *self, struct read_cartridge_location *query) {
+    SimElement **elements = calloc(query->number_elements > 0 ? query->number_elements : 1, sizeof(SimElement *));
+    if (elements == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    int found = sim_elements_from(self, query->element_address, -1, elements, query->number_elements);
+    for (int i = 0; i < query->number_elements; i++) {
+        struct cartridge_location_data *location = &query->data[i];
+        memset(location, 0, sizeof(*location));
+        if (i >= found) continue;
+        struct element_status status;
+        sim_element_status(elements[i], &status);
+        location->address = status.address;
+        location->full = status.full;
+        location->access = status.access;
+        location->svalid = status.svalid;
+        location->source = status.source;
+        memcpy(location->volume, status.volume, sizeof(location->volume));
+    }
+    free(elements);
+    return 0;
+}
+
+static int sim_changer_ioctl(void *state, unsigned long request, void *arg) {
+    SimChanger *self = (SimChanger *) state;
+    switch (request) {
+        case SMCIOC_MOVE_MEDIUM:
+            return sim_move(self, (struct move_medium *) arg);
+        case SMCIOC_EXCHANGE_MEDIUM:
+            return sim_exchange(self, (struct exchange_medium *) arg);
+        case SMCIOC_POS_TO_ELEM:
+            return sim_position(self, (struct pos_to_elem *) arg);
+        default:
+            break;
+    }
+
+    int ret = 0;
+    pthread_mutex_lock(&self->lock);
+    switch (request) {
+        case SMCIOC_ELEMENT_INFO: {
+            struct element_info *query = (struct element_info *) arg;
+            sim_type_range(self, SIM_ROBOT, &query->robot_addr, &query->robots);
+            sim_type_range(self, SIM_SLOT, &query->slot_addr, &query->slots);
+            sim_type_range(self, SIM_DRIVE, &query->drive_addr, &query->drives);
+            sim_type_range(self, SIM_IE_STATION, &query->ie_addr, &query->ie_stations);
+            break;
+        }
+        case SMCIOC_INVENTORY:
+            sim_inventory(self, (struct inventory *) arg);
+            break;
+        case SMCIOC_INIT_ELEM_STAT:
+        case SMCIOC_INIT_ELEM_STAT_RANGE:
+            break;
+        case SMCIOC_READ_ELEMENT_DEVIDS:
+            ret = sim_read_devids(self, (struct read_element_devids *) arg);
+            break;
+        case SMCIOC_READ_CARTRIDGE_LOCATION:
+            ret = sim_read_locations(self, (struct read_cartridge_location *) arg);
+            break;
+        default:
+            errno = ENOTTY;
+            ret = -1;
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    return ret;
+}
+
+static ssize_t sim_changer_read(void *state, void *buffer, size_t length) {
+    errno = EINVAL;
+    return -1;
+}
+
+static ssize_t sim_changer_write(void *state, const void *buffer, size_t length) {
+    errno = EINVAL;
+    return -1;
+}
+
+static void sim_changer_free(SimChanger *self) {
+    pthread_cond_destroy(&self->cond);
+    pthread_mutex_destroy(&self->lock);
+    free(self->elements);
+    free(self->file);
+    free(self);
+}
+
+static void sim_changer_close(void *state) {
+    SimChanger *self = (SimChanger *) state;
+    pthread_mutex_lock(&sim_changers_lock);
+    int last = --self->refs == 0;
+    if (last) {
+        SimChanger **link = &sim_changers;
+        while (*link != self) link = &(*link)->next;
+        *link = self->next;
+    }
+    pthread_mutex_unlock(&sim_changers_lock);
+    if (last) sim_changer_free(self);
+}
+
+static const DeviceOps sim_changer_ops = {
+    .ioctl = sim_changer_ioctl,
+    .read = sim_changer_read,
+    .write = sim_changer_write,
+    .close = sim_changer_close,
+};
+
+void *sim_changer_open(const char *file, const DeviceOps **ops) {
+    *ops = &sim_changer_ops;
+    pthread_mutex_lock(&sim_changers_lock);
+    for (SimChanger *self = sim_changers; self != NULL; self = self->next) {
+        if (!strcmp(self->file, file)) {
+            self->refs++;
+            pthread_mutex_unlock(&sim_changers_lock);
+            return self;
+        }
+    }
+    SimChanger *self = calloc(1, sizeof(SimChanger));
+    if (self == NULL || (self->file = strdup(file)) == NULL) {
+        pthread_mutex_unlock(&sim_changers_lock);
+        free(self);
+        errno = ENOMEM;
+        return NULL;
+    }
+    pthread_mutex_init(&self->lock, NULL);
+    pthread_cond_init(&self->cond, NULL);
+    if (sim_changer_load(self)) {
+        int error = errno;
+        pthread_mutex_unlock(&sim_changers_lock);
+        sim_changer_free(self);
+        errno = error;
+        return NULL;
+    }
+    self->refs = 1;
+    self->next = sim_changers;
+    sim_changers = self;
+    pthread_mutex_unlock(&sim_changers_lock);
+    return self;
+}
@@ -0,0 +1,699 @@
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <linux/version.h>
+#include "IBM_tape.h"
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include "device.h"
+
+#define SIM_TAPE_PARTITIONS 4
+#define SIM_RECORD_HEADER 8
+#define SIM_RECORD_FILEMARK 1
+#define SIM_MAX_BLOCK_SIZE (8 * 1024 * 1024)
+
+
+/* A tape is a directory with one file per partition. Every record on the tape is
+ * a little endian header of the length and the flags followed by the data, a
+ * filemark is a header with the filemark flag. Optional "config" file of
+ * "key value" lines sets the identity of the drive and the timing model. */
+typedef struct {
+    uint64_t offset;
+    uint32_t length;
+    int filemark;
+} SimRecord;
+
+typedef struct {
+    int fd;
+    SimRecord *records;
+    size_t count;
+    size_t capacity;
+} SimPartition;
+
+typedef struct {
+    pthread_mutex_t lock;
+    char *directory;
+    SimPartition partitions[SIM_TAPE_PARTITIONS];
+    int partitions_count;
+    int partition_type;
+    int partition_method;
+    int size_unit;
+    unsigned short sizes[SIM_TAPE_PARTITIONS];
+    int active;
+    size_t position;
+    int loaded;
+    char serial[32];
+    char volume[16];
+    unsigned int density_code;
+    unsigned int medium_type;
+    unsigned int wraps;
+    double capacity;
+    /* Timing model, in seconds */
+    double locate_time;
+    double locate_block_time;
+    double partition_time;
+    double load_time;
+    double unload_time;
+    double bandwidth;
+} SimTape;
+
+static void sim_put_le(unsigned char *dest, uint32_t value) {
+    for (int i = 0; i < 4; i++) dest[i] = (value >> (8 * i)) & 0xff;
+}
+
+static uint32_t sim_get_le(const unsigned char *src) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) value = (value << 8) | src[i];
+    return value;
+}
+
+static void sim_put_be(unsigned char *dest, unsigned long long value, size_t bytes) {
+    unsigned char buffer[8];
+    for (int i = 7; i >= 0; i--) {
+        buffer[i] = value & 0xff;
+        value >>= 8;
+    }
+    memcpy(dest, buffer + sizeof(buffer) - bytes, bytes);
+}
+
+static int sim_partition_append(SimPartition *partition, uint64_t offset, uint32_t length, int filemark) {
+    if (partition->count == partition->capacity) {
+        size_t capacity = partition->capacity ? partition->capacity * 2 : 1024;
+        SimRecord *records = realloc(partition->records, capacity * sizeof(SimRecord));
+        if (records == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        partition->records = records;
+        partition->capacity = capacity;
+    }
+    SimRecord *record = &partition->records[partition->count++];
+    record->offset = offset;
+    record->length = length;
+    record->filemark = filemark;
+    return 0;
+}
+
+static uint64_t sim_partition_end(SimPartition *partition) {
+    if (partition->count == 0) return 0;
+    SimRecord *last = &partition->records[partition->count - 1];
+    return last->offset + SIM_RECORD_HEADER + last->length;
+}
+
+/* Indexes records of the partition file, a torn record at the end is cut off */
+static int sim_partition_scan(SimPartition *partition) {
+    uint64_t offset = 0;
+    unsigned char header[SIM_RECORD_HEADER];
+    struct stat status;
+    if (fstat(partition->fd, &status)) {
+        return -1;
+    }
+    while (offset + SIM_RECORD_HEADER <= (uint64_t) status.st_size) {
+        if (pread(partition->fd, header, SIM_RECORD_HEADER, offset) != SIM_RECORD_HEADER) {
+            break;
+        }
+        uint32_t length = sim_get_le(header);
+        int filemark = sim_get_le(header + 4) & SIM_RECORD_FILEMARK;
+        if (offset + SIM_RECORD_HEADER + length > (uint64_t) status.st_size) {
+            break;
+        }
+        if (sim_partition_append(partition, offset, length, filemark)) {
+            return -1;
+        }
+        offset += SIM_RECORD_HEADER + length;
+    }
+    if ((uint64_t) status.st_size != offset && ftruncate(partition->fd, offset)) {
+        return -1;
+    }
+    return 0;
+}
+
+static int sim_partition_open(SimTape *self, int index, int truncate) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/partition%d", self->directory, index);
+    SimPartition *partition = &self->partitions[index];
+    partition->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+    if (partition->fd < 0) {
+        return -1;
+    }
+    partition->count = 0;
+    return sim_partition_scan(partition);
+}
+
+static void sim_partition_close(SimPartition *partition) {
+    if (partition->fd >= 0) close(partition->fd);
+    free(partition->records);
+    memset(partition, 0, sizeof(SimPartition));
+    partition->fd = -1;
+}
+
+/* Writing anywhere but at the end of data drops everything after the position */
+static int sim_truncate(SimTape *self) {
+    SimPartition *partition = &self->partitions[self->active];
+    if (self->position >= partition->count) {
+        return 0;
+    }
+    if (ftruncate(partition->fd, partition->records[self->position].offset)) {
+        return -1;
+    }
+    partition->count = self->position;
+    return 0;
+}
+
+static int sim_append(SimTape *self, const void *data, uint32_t length, int filemark) {
+    if (sim_truncate(self)) {
+        return -1;
+    }
+    SimPartition *partition = &self->partitions[self->active];
+    uint64_t offset = sim_partition_end(partition);
+    unsigned char header[SIM_RECORD_HEADER];
+    sim_put_le(header, length);
+    sim_put_le(header + 4, filemark ? SIM_RECORD_FILEMARK : 0);
+    struct iovec parts[2] = {{header, SIM_RECORD_HEADER}, {(void *) data, length}};
+    ssize_t written = pwritev(partition->fd, parts, length > 0 ? 2 : 1, offset);
+    if (written != (ssize_t) (SIM_RECORD_HEADER + length)) {
+        if (written >= 0) errno = EIO;
+        return -1;
+    }
+    if (sim_partition_append(partition, offset, length, filemark)) {
+        return -1;
+    }
+    self->position = partition->count;
+    return 0;
+}
+
+static size_t sim_filemarks_before(SimPartition *partition, size_t position) {
+    size_t filemarks = 0;
+    for (size_t i = 0; i < position && i < partition->count; i++) filemarks += partition->records[i].filemark;
+    return filemarks;
+}
+
+static double sim_locate_cost(SimTape *self, int partition, size_t position) {
+    double cost = self->locate_time;
+    size_t distance = position > self->position ? position - self->position : self->position - position;
+    if (partition != self->active) {
+        cost += self->partition_time;
+        distance = position + self->position;
+    }
+    return cost + distance * self->locate_block_time;
+}
+
+static void sim_config_load(SimTape *self) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/config", self->directory);
+    FILE *config = fopen(path, "r");
+    if (config == NULL) {
+        return;
+    }
+    char key[64], value[256];
+    while (fscanf(config, "%63s %255s", key, value) == 2) {
+        if (!strcmp(key, "serial")) snprintf(self->serial, sizeof(self->serial), "%.31s", value);
+        else if (!strcmp(key, "volume")) memcpy(self->volume, value, strnlen(value, sizeof(self->volume)));
+        else if (!strcmp(key, "density_code")) self->density_code = strtoul(value, NULL, 0);
+        else if (!strcmp(key, "medium_type")) self->medium_type = strtoul(value, NULL, 0);
+        else if (!strcmp(key, "wraps")) self->wraps = strtoul(value, NULL, 0);
+        else if (!strcmp(key, "capacity")) self->capacity = strtod(value, NULL);
+        else if (!strcmp(key, "locate_time")) self->locate_time = strtod(value, NULL);
+        else if (!strcmp(key, "locate_block_time")) self->locate_block_time = strtod(value, NULL);
+        else if (!strcmp(key, "partition_time")) self->partition_time = strtod(value, NULL);
+        else if (!strcmp(key, "load_time")) self->load_time = strtod(value, NULL);
+        else if (!strcmp(key, "unload_time")) self->unload_time = strtod(value, NULL);
+        else if (!strcmp(key, "bandwidth")) self->bandwidth = strtod(value, NULL);
+    }
+    fclose(config);
+}
+
+/* Layout is kept in the "layout" file as "count type method size_unit sizes..." */
+static void sim_layout_load(SimTape *self) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/layout", self->directory);
+    FILE *layout = fopen(path, "r");
+    self->partitions_count = 1;
+    if (layout == NULL) {
+        return;
+    }
+    int count, type, method, size_unit;
+    if (fscanf(layout, "%d %d %d %d", &count, &type, &method, &size_unit) == 4 && count >= 1 && count <= SIM_TAPE_PARTITIONS) {
+        self->partitions_count = count;
+        self->partition_type = type;
+        self->partition_method = method;
+        self->size_unit = size_unit;
+        for (int i = 0; i < count; i++) {
+            unsigned int size;
+            if (fscanf(layout, "%u", &size) != 1) break;
+            self->sizes[i] = (unsigned short) size;
+        }
+    }
+    fclose(layout);
+}
+
+static int sim_layout_save(SimTape *self) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/layout", self->directory);
+    FILE *layout = fopen(path, "w");
+    if (layout == NULL) {
+        return -1;
+    }
+    fprintf(layout, "%d %d %d %d", self->partitions_count, self->partition_type, self->partition_method, self->size_unit);
+    for (int i = 0; i < self->partitions_count; i++) fprintf(layout, " %u", self->sizes[i]);
+    fprintf(layout, "\n");
+    return fclose(layout);
+}
+
+/* Sizes which are not given are derived from the wraps of the medium like a drive would */
+static void sim_layout_sizes(SimTape *self) {
+    int count = self->partitions_count;
+    unsigned int usable = self->wraps - 2 * (count - 1);
+    unsigned int wraps[SIM_TAPE_PARTITIONS] = {0};
+    if (count == 1) {
+        wraps[0] = self->wraps;
+    } else if (self->partition_type == 3) {
+        /* FDP, the second partition is as small as possible */
+        wraps[0] = usable - 2;
+        wraps[1] = 2;
+    } else if (self->partition_type == 2 || self->partition_type == 0) {
+        for (int i = 0; i < count; i++) wraps[i] = usable / count + (i == count - 1 ? usable % count : 0);
+    } else {
+        return;
+    }
+    double wrap_size = self->capacity / self->wraps;
+    self->size_unit = 9;
+    for (int i = 0; i < count; i++) self->sizes[i] = (unsigned short) (wraps[i] * wrap_size / 1e9);
+}
+
+static int sim_space_filemarks(SimTape *self, long count) {
+    SimPartition *partition = &self->partitions[self->active];
+    for (; count > 0; count--) {
+        while (self->position < partition->count && !partition->records[self->position].filemark) self->position++;
+        if (self->position >= partition->count) {
+            errno = EIO;
+            return -1;
+        }
+        self->position++;
+    }
+    for (; count < 0; count++) {
+        if (self->position == 0) {
+            errno = EIO;
+            return -1;
+        }
+        self->position--;
+        while (self->position > 0 && !partition->records[self->position].filemark) self->position--;
+        if (!partition->records[self->position].filemark) {
+            errno = EIO;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int sim_space_records(SimTape *self, long count) {
+    SimPartition *partition = &self->partitions[self->active];
+    for (; count > 0; count--) {
+        if (self->position >= partition->count) {
+            errno = EIO;
+            return -1;
+        }
+        if (partition->records[self->position++].filemark) {
+            errno = EIO;
+            return -1;
+        }
+    }
+    for (; count < 0; count++) {
+        if (self->position == 0) {
+            errno = EIO;
+            return -1;
+        }
+        if (partition->records[--self->position].filemark) {
+            errno = EIO;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Loading and rewinding go to the beginning of partition 0, whatever was active before */
+static void sim_load_position(SimTape *self) {
+    self->active = 0;
+    self->position = 0;
+}
+
+static int sim_tape_operation(SimTape *self, struct stop *query, double *cost) {
+    SimPartition *partition = &self->partitions[self->active];
+    switch (query->st_op) {
+        case STREW:
+        case STRETEN:
+            *cost = sim_locate_cost(self, self->active, 0);
+            sim_load_position(self);
+            return 0;
+        case STOFFL:
+        case STEJECT:
+            *cost = sim_locate_cost(self, self->active, 0) + self->unload_time;
+            self->position = 0;
+            self->loaded = 0;
+            return 0;
+        case STINSRT:
+        case STLOAD:
+            *cost = self->loaded ? 0 : self->load_time;
+            self->loaded = 1;
+            sim_load_position(self);
+            return 0;
+        case STTUR:
+            return 0;
+        case STERASE:
+            return sim_truncate(self);
+        case STWEOF:
+            for (long i = 0; i < query->st_count; i++) {
+                if (sim_append(self, NULL, 0, 1)) return -1;
+            }
+            return 0;
+        case STFSF:
+        case STRSF: {
+            size_t start = self->position;
+            int ret = sim_space_filemarks(self, query->st_op == STFSF ? query->st_count : -query->st_count);
+            *cost = self->locate_time + (self->position > start ? self->position - start : start - self->position) * self->locate_block_time;
+            return ret;
+        }
+        case STFSR:
+            return sim_space_records(self, query->st_count);
+        case STRSR:
+            return sim_space_records(self, -query->st_count);
+        case STSEOD:
+            *cost = sim_locate_cost(self, self->active, partition->count);
+            self->position = partition->count;
+            return 0;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+}
+
+static int sim_locate_file(SimTape *self, unsigned long long file_id) {
+    SimPartition *partition = &self->partitions[self->active];
+    size_t position = 0;
+    for (unsigned long long filemarks = 0; filemarks < file_id; position++) {
+        if (position >= partition->count) {
+            self->position = partition->count;
+            errno = EIO;
+            return -1;
+        }
+        filemarks += partition->records[position].filemark;
+    }
+    self->position = position;
+    return 0;
+}
+
+static int sim_locate_block(SimTape *self, size_t position) {
+    SimPartition *partition = &self->partitions[self->active];
+    if (position > partition->count) {
+        self->position = partition->count;
+        errno = EIO;
+        return -1;
+    }
+    self->position = position;
+    return 0;
+}
+
+static int sim_create_partitions(SimTape *self, struct tape_partition *query) {
+    int count = query->number_of_partitions;
+    if (query->type == 3) count = 2;
+    if (count < 1 || count > SIM_TAPE_PARTITIONS) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (int i = 0; i < SIM_TAPE_PARTITIONS; i++) {
+        char path[4096];
+        sim_partition_close(&self->partitions[i]);
+        snprintf(path, sizeof(path), "%s/partition%d", self->directory, i);
+        unlink(path);
+    }
+    self->partitions_count = count;
+    self->partition_type = query->type;
+    self->partition_method = query->partition_method;
+    self->size_unit = query->size_unit;
+    for (int i = 0; i < SIM_TAPE_PARTITIONS; i++) self->sizes[i] = i < count ? query->size[i] : 0;
+    if (query->type != 1) sim_layout_sizes(self);
+    self->active = 0;
+    self->position = 0;
+    for (int i = 0; i < count; i++) {
+        if (sim_partition_open(self, i, 1)) return -1;
+    }
+    return sim_layout_save(self);
+}
+
+static void sim_read_position(SimTape *self, struct read_tape_position *query) {
+    SimPartition *partition = &self->partitions[self->active];
+    unsigned char format = query->data_format;
+    memset(&query->rp_data, 0, sizeof(query->rp_data));
+    if (format == RP_LONG_FORM) {
+        struct long_data_format *data = &query->rp_data.rp_long;
+        data->bop = self->position == 0;
+        data->active_partition = self->active;
+        sim_put_be(data->logical_obj_number, self->position, sizeof(data->logical_obj_number));
+        sim_put_be(data->logical_file_id, sim_filemarks_before(partition, self->position), sizeof(data->logical_file_id));
+    } else if (format == RP_EXTENDED_FORM) {
+        struct extended_data_format *data = &query->rp_data.rp_extended;
+        data->bop = self->position == 0;
+        data->active_partition = self->active;
+        sim_put_be(data->additional_length, 0x1C, sizeof(data->additional_length));
+        sim_put_be(data->first_logical_obj_position, self->position, sizeof(data->first_logical_obj_position));
+        sim_put_be(data->last_logical_obj_position, self->position, sizeof(data->last_logical_obj_position));
+    } else {
+        struct short_data_format *data = &query->rp_data.rp_short;
+        data->bop = self->position == 0;
+        data->active_partition = self->active;
+        sim_put_be(data->first_logical_obj_position, self->position, sizeof(data->first_logical_obj_position));
+        sim_put_be(data->last_logical_obj_position, self->position, sizeof(data->last_logical_obj_position));
+    }
+}
+
+static int sim_tape_ioctl(void *state, unsigned long request, void *arg) {
+    SimTape *self = (SimTape *) state;
+    double cost = 0;
+    int ret = 0;
+
+    pthread_mutex_lock(&self->lock);
+    SimPartition *partition = &self->partitions[self->active];
+    switch (request) {
+        case STIOCTOP:
+            ret = sim_tape_operation(self, (struct stop *) arg, &cost);
+            break;
+        case STIOCSYNC:
+            ret = fsync(partition->fd);
+            break;
+        case STIOC_LOCATE_16: {
+            struct set_tape_position *query = (struct set_tape_position *) arg;
+            size_t start = self->position;
+            if (query->logical_id_type == LOGICAL_ID_FILE_TYPE) {
+                ret = sim_locate_file(self, query->logical_id);
+            } else {
+                ret = sim_locate_block(self, query->logical_id);
+            }
+            size_t target = self->position;
+            self->position = start;
+            cost = sim_locate_cost(self, self->active, target);
+            self->position = target;
+            break;
+        }
+        case STIOC_SET_ACTIVE_PARTITION: {
+            struct set_active_partition *query = (struct set_active_partition *) arg;
+            if (query->partition_number >= self->partitions_count) {
+                errno = EINVAL;
+                ret = -1;
+                break;
+            }
+            cost = sim_locate_cost(self, query->partition_number, query->logical_block_id);
+            self->active = query->partition_number;
+            ret = sim_locate_block(self, query->logical_block_id);
+            break;
+        }
+        case STIOCQRYPOS: {
+            struct stpos_s *query = (struct stpos_s *) arg;
+            memset(query, 0, sizeof(*query));
+            query->block_type = QP_LOGICAL;
+            query->bot = self->position == 0;
+            query->curpos = self->position;
+            query->tapepos = self->position;
+            query->lbot = partition->count > 0 ? partition->count - 1 : LBOT_NONE;
+            query->partition_number = self->active;
+            break;
+        }
+        case STIOC_READ_POSITION_EX:
+            sim_read_position(self, (struct read_tape_position *) arg);
+            break;
+        case STIOCQRYP: {
+            struct stchgp_s *query = (struct stchgp_s *) arg;
+            memset(query, 0, sizeof(*query));
+            query->buffered_mode = 1;
+            query->min_blksize = 1;
+            query->max_blksize = SIM_MAX_BLOCK_SIZE;
+            query->max_scsi_xfer = SIM_MAX_BLOCK_SIZE;
+            query->density_code = self->density_code;
+            query->medium_type = self->medium_type;
+            memcpy(query->volid, self->volume, sizeof(query->volid));
+            break;
+        }
+        case STIOC_QUERY_PARTITION: {
+            struct query_partition *query = (struct query_partition *) arg;
+            memset(query, 0, sizeof(*query));
+            query->max_partitions = SIM_TAPE_PARTITIONS;
+            query->active_partition = self->active;
+            query->number_of_partitions = self->partitions_count;
+            query->size_unit = self->size_unit;
+            for (int i = 0; i < self->partitions_count; i++) query->size[i] = self->sizes[i];
+            query->partition_method = self->partition_method;
+            break;
+        }
+        case STIOC_CREATE_PARTITION:
+            ret = sim_create_partitions(self, (struct tape_partition *) arg);
+            break;
+        case STIOC_LOAD_UNLOAD: {
+            struct tape_load_unload *query = (struct tape_load_unload *) arg;
+            if (!query->immediate) {
+                cost = query->load ? (self->loaded ? 0 : self->load_time) : sim_locate_cost(self, self->active, 0) + self->unload_time;
+            }
+            self->loaded = query->load;
+            if (query->load) sim_load_position(self);
+            else self->position = 0;
+            break;
+        }
+        case SIOC_INQUIRY: {
+            struct inquiry_data *query = (struct inquiry_data *) arg;
+            memset(query, 0, sizeof(*query));
+            query->type = 1;
+            query->rm = 1;
+            memcpy(query->vid, "IBM     ", VEND_ID_LEN);
+            memcpy(query->pid, "ULT3580-SIM     ", PROD_ID_LEN);
+            memcpy(query->revision, "0001", REV_LEN);
+            break;
+        }
+        case SIOC_INQUIRY_PAGE: {
+            struct inquiry_page *query = (struct inquiry_page *) arg;
+            if (query->page_code != 0x80) {
+                errno = EINVAL;
+                ret = -1;
+                break;
+            }
+            size_t length = strlen(self->serial);
+            memset(query->data, 0, sizeof(query->data));
+            query->data[0] = 1;
+            query->data[1] = 0x80;
+            query->data[3] = (char) length;
+            memcpy(query->data + 4, self->serial, length);
+            break;
+        }
+        default:
+            errno = ENOTTY;
+            ret = -1;
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    sim_sleep(cost);
+    return ret;
+}
+
+static ssize_t sim_tape_read(void *state, void *buffer, size_t length) {
+    SimTape *self = (SimTape *) state;
+    pthread_mutex_lock(&self->lock);
+    SimPartition *partition = &self->partitions[self->active];
+    if (!self->loaded || self->position >= partition->count) {
+        pthread_mutex_unlock(&self->lock);
+        errno = EIO;
+        return -1;
+    }
+    SimRecord *record = &partition->records[self->position];
+    if (record->filemark) {
+        self->position++;
+        pthread_mutex_unlock(&self->lock);
+        return 0;
+    }
+    if (record->length > length) {
+        pthread_mutex_unlock(&self->lock);
+        errno = ENOMEM;
+        return -1;
+    }
+    ssize_t done = pread(partition->fd, buffer, record->length, record->offset + SIM_RECORD_HEADER);
+    if (done == (ssize_t) record->length) {
+        self->position++;
+    } else if (done >= 0) {
+        errno = EIO;
+        done = -1;
+    }
+    double cost = self->bandwidth > 0 && done > 0 ? done / self->bandwidth : 0;
+    pthread_mutex_unlock(&self->lock);
+
+    sim_sleep(cost);
+    return done;
+}
+
+static ssize_t sim_tape_write(void *state, const void *buffer, size_t length) {
+    SimTape *self = (SimTape *) state;
+    if (length == 0 || length > SIM_MAX_BLOCK_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_lock(&self->lock);
+    int ret = self->loaded ? sim_append(self, buffer, (uint32_t) length, 0) : (errno = EIO, -1);
+    double cost = self->bandwidth > 0 && ret == 0 ? length / self->bandwidth : 0;
+    pthread_mutex_unlock(&self->lock);
+
+    sim_sleep(cost);
+    return ret ? -1 : (ssize_t) length;
+}
+
+static void sim_tape_close(void *state) {
+    SimTape *self = (SimTape *) state;
+    for (int i = 0; i < SIM_TAPE_PARTITIONS; i++) sim_partition_close(&self->partitions[i]);
+    pthread_mutex_destroy(&self->lock);
+    free(self->directory);
+    free(self);
+}
+
+static const DeviceOps sim_tape_ops = {
+    .ioctl = sim_tape_ioctl,
+    .read = sim_tape_read,
+    .write = sim_tape_write,
+    .close = sim_tape_close,
+};
+
+void *sim_tape_open(const char *directory, const DeviceOps **ops) {
+    if (mkdir(directory, 0755) && errno != EEXIST) {
+        return NULL;
+    }
+    SimTape *self = calloc(1, sizeof(SimTape));
+    if (self == NULL || (self->directory = strdup(directory)) == NULL) {
+        free(self);
+        errno = ENOMEM;
+        return NULL;
+    }
+    pthread_mutex_init(&self->lock, NULL);
+    for (int i = 0; i < SIM_TAPE_PARTITIONS; i++) self->partitions[i].fd = -1;
+    /* LTO-7 unless configured otherwise */
+    snprintf(self->serial, sizeof(self->serial), "SIM0000001");
+    self->density_code = 0x5c;
+    self->medium_type = 0x78;
+    self->wraps = 112;
+    self->capacity = 6e12;
+    self->loaded = 1;
+    self->partition_method = 1;
+    sim_config_load(self);
+    sim_layout_load(self);
+    if (self->sizes[0] == 0) sim_layout_sizes(self);
+
+    for (int i = 0; i < self->partitions_count; i++) {
+        if (sim_partition_open(self, i, 0)) {
+            int error = errno;
+            sim_tape_close(self);
+            errno = error;
+            return NULL;
+        }
+    }
+    *ops = &sim_tape_ops;
+    return self;
+}
@@ -0,0 +1,836 @@
+#include <Python.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "tape.h"
+#include "device.h"
+
+#define STREAM_BUFFER_ALIGNMENT 4096
+
+
+/* Buffers form a ring: the writer thread owns `queued` buffers starting at
+ * `head`, the buffer right after them is the one being packed by Python. */
+typedef struct {
+    PyObject_HEAD
+    TapeDeviceObject *device;
+    int fd;
+    size_t block_size;
+    int buffers_count;
+    char **buffers;
+    size_t *lengths;
+    size_t fill_length;
+    int head;
+    int queued;
+    int closing;
+    int error;
+    int busy;
+    unsigned long long blocks_written;
+    unsigned long long bytes_written;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int thread_started;
+} TapeWriterObject;
+
+static void *writer_thread(void *arg) {
+    TapeWriterObject *self = (TapeWriterObject *) arg;
+
+    pthread_mutex_lock(&self->lock);
+    for (;;) {
+        while (self->queued == 0 && !self->closing) {
+            pthread_cond_wait(&self->cond, &self->lock);
+        }
+        if (self->queued == 0) {
+            break;
+        }
+        int index = self->head;
+        size_t length = self->lengths[index];
+        pthread_mutex_unlock(&self->lock);
+
+        ssize_t written = dev_write(self->fd, self->buffers[index], length);
+        int error = 0;
+        if (written < 0) error = errno;
+        else if ((size_t) written != length) error = EIO;
+
+        pthread_mutex_lock(&self->lock);
+        if (error) {
+            self->error = error;
+            self->queued = 0;
+            pthread_cond_broadcast(&self->cond);
+            break;
+        }
+        self->head = (self->head + 1) % self->buffers_count;
+        self->queued--;
+        self->blocks_written++;
+        self->bytes_written += length;
+        pthread_cond_broadcast(&self->cond);
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    return NULL;
+}
+
+/* Both helpers below are called without the GIL and with the lock held. */
+static void writer_submit(TapeWriterObject *self) {
+    int index = (self->head + self->queued) % self->buffers_count;
+    self->lengths[index] = self->fill_length;
+    self->fill_length = 0;
+    self->queued++;
+    pthread_cond_broadcast(&self->cond);
+}
+
+static void writer_wait_idle(TapeWriterObject *self) {
+    while (self->queued > 0 && !self->error) {
+        pthread_cond_wait(&self->cond, &self->lock);
+    }
+}
+
+static int writer_pack(TapeWriterObject *self, const char *data, size_t length) {
+    pthread_mutex_lock(&self->lock);
+    while (length > 0 && !self->error) {
+        while (self->queued == self->buffers_count && !self->error) {
+            pthread_cond_wait(&self->cond, &self->lock);
+        }
+        if (self->error) {
+            break;
+        }
+        int index = (self->head + self->queued) % self->buffers_count;
+        pthread_mutex_unlock(&self->lock);
+
+        size_t chunk = self->block_size - self->fill_length;
+        if (chunk > length) chunk = length;
+        memcpy(self->buffers[index] + self->fill_length, data, chunk);
+        self->fill_length += chunk;
+        data += chunk;
+        length -= chunk;
+
+        pthread_mutex_lock(&self->lock);
+        if (self->fill_length == self->block_size) {
+            writer_submit(self);
+        }
+    }
+    int error = self->error;
+    pthread_mutex_unlock(&self->lock);
+
+    return error;
+}
+
+static int writer_flush(TapeWriterObject *self) {
+    pthread_mutex_lock(&self->lock);
+    if (self->fill_length > 0 && !self->error) {
+        writer_submit(self);
+    }
+    writer_wait_idle(self);
+    int error = self->error;
+    pthread_mutex_unlock(&self->lock);
+
+    return error;
+}
+
+static int writer_begin(TapeWriterObject *self) {
+    if (self->fd < 0) {
+        PyErr_SetString(PyExc_ValueError, "Writer is closed.");
+        return -1;
+    }
+    if (self->busy) {
+        PyErr_SetString(PyExc_ValueError, "Writer is busy.");
+        return -1;
+    }
+    self->busy = 1;
+    return 0;
+}
+
+static PyObject *writer_result(TapeWriterObject *self, int error, PyObject *result) {
+    self->busy = 0;
+    if (error) {
+        Py_XDECREF(result);
+        PyErr_Format(PyExc_ValueError, "Failed to write to tape: %s", strerror(error));
+        return NULL;
+    }
+    return result;
+}
+
+static void writer_release(TapeWriterObject *self) {
+    if (self->thread_started) {
+        pthread_mutex_lock(&self->lock);
+        self->closing = 1;
+        pthread_cond_broadcast(&self->cond);
+        pthread_mutex_unlock(&self->lock);
+        pthread_join(self->thread, NULL);
+        self->thread_started = 0;
+    }
+    if (self->buffers != NULL) {
+        for (int i = 0; i < self->buffers_count; i++) free(self->buffers[i]);
+        free(self->buffers);
+        self->buffers = NULL;
+    }
+    free(self->lengths);
+    self->lengths = NULL;
+    if (self->device != NULL) {
+        tape_device_stream_end(self->device, self->blocks_written, 0, self->error);
+        tape_device_release(self->device);
+        Py_CLEAR(self->device);
+    }
+    self->fd = -1;
+}
+
+static int tape_writer_init(TapeWriterObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"device", "block_size", "buffers", NULL};
+    TapeDeviceObject *device;
+    Py_ssize_t block_size;
+    int buffers_count = 2;
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "O!n|i", kwlist, &TapeDeviceType, &device, &block_size, &buffers_count)) {
+        return -1;
+    }
+    if (self->fd >= 0) {
+        PyErr_SetString(PyExc_ValueError, "Writer is already open.");
+        return -1;
+    }
+    if (block_size <= 0 || buffers_count < 2) {
+        PyErr_SetString(PyExc_ValueError, "Block size has to be positive and at least two buffers are required.");
+        return -1;
+    }
+
+    int fd = tape_device_acquire(device);
+    if (fd < 0) {
+        return -1;
+    }
+    Py_INCREF(device);
+    self->device = device;
+    self->fd = fd;
+    tape_device_stream_begin(device);
+    self->block_size = (size_t) block_size;
+    self->buffers_count = buffers_count;
+
+    self->lengths = calloc(buffers_count, sizeof(size_t));
+    self->buffers = calloc(buffers_count, sizeof(char *));
+    if (self->lengths == NULL || self->buffers == NULL) {
+        writer_release(self);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (int i = 0; i < buffers_count; i++) {
+        if (posix_memalign((void **) &self->buffers[i], STREAM_BUFFER_ALIGNMENT, self->block_size)) {
+            self->buffers[i] = NULL;
+            writer_release(self);
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+
+    if (pthread_create(&self->thread, NULL, writer_thread, self)) {
+        writer_release(self);
+        PyErr_SetString(PyExc_ValueError, "Failed to start writer thread.");
+        return -1;
+    }
+    self->thread_started = 1;
+
+    return 0;
+}
+
+static PyObject *tape_writer_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    TapeWriterObject *self = (TapeWriterObject *) type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->fd = -1;
+        pthread_mutex_init(&self->lock, NULL);
+        pthread_cond_init(&self->cond, NULL);
+    }
+    return (PyObject *) self;
+}
+
+static void tape_writer_dealloc(TapeWriterObject *self) {
+    if (self->fd >= 0 && !self->busy) {
+        Py_BEGIN_ALLOW_THREADS
+        writer_flush(self);
+        Py_END_ALLOW_THREADS
+    }
+    writer_release(self);
+    pthread_cond_destroy(&self->cond);
+    pthread_mutex_destroy(&self->lock);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *method_write(TapeWriterObject *self, PyObject *args) {
+    Py_buffer data;
+    if(!PyArg_ParseTuple(args, "y*", &data)) {
+        return NULL;
+    }
+    if (writer_begin(self) < 0) {
+        PyBuffer_Release(&data);
+        return NULL;
+    }
+
+    int error;
+    Py_BEGIN_ALLOW_THREADS
+    error = writer_pack(self, (const char *) data.buf, (size_t) data.len);
+    Py_END_ALLOW_THREADS
+    PyObject *result = PyLong_FromSsize_t(data.len);
+    PyBuffer_Release(&data);
+
+    return writer_result(self, error, result);
+}
+
+static PyObject *method_flush(TapeWriterObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (writer_begin(self) < 0) {
+        return NULL;
+    }
+
+    int error;
+    Py_BEGIN_ALLOW_THREADS
+    error = writer_flush(self);
+    Py_END_ALLOW_THREADS
+
+    Py_INCREF(Py_None);
+    return writer_result(self, error, Py_None);
+}
+
+static PyObject *method_writer_close(TapeWriterObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->fd < 0) {
+        Py_RETURN_NONE;
+    }
+    if (writer_begin(self) < 0) {
+        return NULL;
+    }
+
+    int error;
+    Py_BEGIN_ALLOW_THREADS
+    error = writer_flush(self);
+    Py_END_ALLOW_THREADS
+    writer_release(self);
+
+    Py_INCREF(Py_None);
+    return writer_result(self, error, Py_None);
+}
+
+static PyObject *method_writer_enter(TapeWriterObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->fd < 0) {
+        PyErr_SetString(PyExc_ValueError, "Writer is closed.");
+        return NULL;
+    }
+
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
+static PyObject *method_writer_exit(TapeWriterObject *self, PyObject *args) {
+    return method_writer_close(self, NULL);
+}
+
+static PyObject *tape_writer_get_closed(TapeWriterObject *self, void *closure) {
+    return PyBool_FromLong(self->fd < 0);
+}
+
+static PyObject *tape_writer_get_block_size(TapeWriterObject *self, void *closure) {
+    return PyLong_FromSize_t(self->block_size);
+}
+
+static PyObject *tape_writer_get_blocks_written(TapeWriterObject *self, void *closure) {
+    pthread_mutex_lock(&self->lock);
+    unsigned long long blocks = self->blocks_written;
+    pthread_mutex_unlock(&self->lock);
+    return PyLong_FromUnsignedLongLong(blocks);
+}
+
+static PyObject *tape_writer_get_bytes_written(TapeWriterObject *self, void *closure) {
+    pthread_mutex_lock(&self->lock);
+    unsigned long long bytes = self->bytes_written;
+    pthread_mutex_unlock(&self->lock);
+    return PyLong_FromUnsignedLongLong(bytes);
+}
+
+static PyMethodDef tape_writer_methods[] = {
+    {"write", (PyCFunction) method_write, METH_VARARGS, "Pack bytes-like object into tape blocks"},
+    {"flush", (PyCFunction) method_flush, METH_NOARGS, "Write the partial block and wait until all blocks are on the device"},
+    {"close", (PyCFunction) method_writer_close, METH_NOARGS, "Flush and stop the writer thread"},
+    {"__enter__", (PyCFunction) method_writer_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction) method_writer_exit, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef tape_writer_getset[] = {
+    {"closed", (getter) tape_writer_get_closed, NULL, "True if the writer is closed", NULL},
+    {"block_size", (getter) tape_writer_get_block_size, NULL, "Size of the written blocks", NULL},
+    {"blocks_written", (getter) tape_writer_get_blocks_written, NULL, "Number of blocks written to the device", NULL},
+    {"bytes_written", (getter) tape_writer_get_bytes_written, NULL, "Number of bytes written to the device", NULL},
+    {NULL}
+};
+
+PyTypeObject TapeWriterType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.tape.TapeWriter",
+    .tp_doc = "Block writer streaming through a ring of buffers on a native thread",
+    .tp_basicsize = sizeof(TapeWriterObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = tape_writer_new,
+    .tp_init = (initproc) tape_writer_init,
+    .tp_dealloc = (destructor) tape_writer_dealloc,
+    .tp_methods = tape_writer_methods,
+    .tp_getset = tape_writer_getset,
+};
+
+
+enum reader_slot_state {SLOT_FREE, SLOT_FILLED, SLOT_CURRENT, SLOT_HELD};
+enum reader_slot_kind {SLOT_BLOCK, SLOT_FILEMARK, SLOT_ERROR};
+
+/* A slot is CURRENT while Python reads from it and HELD when Python moved on
+ * but memoryviews of it are still alive; it is reused only when FREE. */
+typedef struct {
+    char *data;
+    size_t length;
+    int kind;
+    int state;
+    int error;
+    Py_ssize_t exports;
+} ReaderSlot;
+
+typedef struct {
+    PyObject_HEAD
+    TapeDeviceObject *device;
+    int fd;
+    size_t block_size;
+    int slots_count;
+    ReaderSlot *slots;
+    int head;
+    int tail;
+    int current;
+    size_t offset;
+    int paused;
+    int closing;
+    int busy;
+    int exposing;
+    int pending_filemark;
+    PyObject *pending_type;
+    PyObject *pending_value;
+    PyObject *pending_traceback;
+    unsigned long long blocks_read;
+    unsigned long long bytes_read;
+    unsigned long long filemarks_read;
+    /* What the thread read from the device, ahead of what Python took */
+    unsigned long long device_blocks;
+    unsigned long long device_filemarks;
+    int device_error;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int thread_started;
+} TapeReaderObject;
+
+static void *reader_thread(void *arg) {
+    TapeReaderObject *self = (TapeReaderObject *) arg;
+
+    pthread_mutex_lock(&self->lock);
+    for (;;) {
+        while (!self->closing && (self->paused || self->slots[self->tail].state != SLOT_FREE)) {
+            pthread_cond_wait(&self->cond, &self->lock);
+        }
+        if (self->closing) {
+            break;
+        }
+        ReaderSlot *slot = &self->slots[self->tail];
+        pthread_mutex_unlock(&self->lock);
+
+        ssize_t length = dev_read(self->fd, slot->data, self->block_size);
+        int error = length < 0 ? errno : 0;
+
+        pthread_mutex_lock(&self->lock);
+        if (length > 0) self->device_blocks++;
+        else if (length == 0) self->device_filemarks++;
+        else self->device_error = error;
+        if (length > 0) {
+            slot->kind = SLOT_BLOCK;
+            slot->length = (size_t) length;
+        } else {
+            /* Stop reading ahead past a filemark or an error until Python gets there */
+            slot->kind = length == 0 ? SLOT_FILEMARK : SLOT_ERROR;
+            slot->length = 0;
+            slot->error = error;
+            self->paused = 1;
+        }
+        slot->state = SLOT_FILLED;
+        self->tail = (self->tail + 1) % self->slots_count;
+        pthread_cond_broadcast(&self->cond);
+    }
+    pthread_mutex_unlock(&self->lock);
+
+    return NULL;
+}
+
+static void reader_release_current(TapeReaderObject *self) {
+    if (self->current < 0) {
+        return;
+    }
+    ReaderSlot *slot = &self->slots[self->current];
+    pthread_mutex_lock(&self->lock);
+    slot->state = slot->exports > 0 ? SLOT_HELD : SLOT_FREE;
+    pthread_cond_broadcast(&self->cond);
+    pthread_mutex_unlock(&self->lock);
+    self->current = -1;
+    self->offset = 0;
+}
+
+/* Moves to the next slot filled by the thread. Returns SLOT_BLOCK with the
+ * slot made current, SLOT_FILEMARK, or -1 with an exception set. */
+static int reader_take(TapeReaderObject *self) {
+    reader_release_current(self);
+
+    int index = self->head;
+    ReaderSlot *slot = &self->slots[index];
+    int state;
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&self->lock);
+    while (slot->state == SLOT_FREE && !self->closing) {
+        pthread_cond_wait(&self->cond, &self->lock);
+    }
+    state = slot->state;
+    /* An error stays at the head with the thread paused, so nothing is read past
+     * the failed spot and every later call reports it until the reader is closed */
+    if (state == SLOT_FILLED && slot->kind != SLOT_ERROR) {
+        self->head = (self->head + 1) % self->slots_count;
+        if (slot->kind == SLOT_BLOCK) {
+            slot->state = SLOT_CURRENT;
+        } else {
+            slot->state = SLOT_FREE;
+            self->paused = 0;
+            pthread_cond_broadcast(&self->cond);
+        }
+    }
+    pthread_mutex_unlock(&self->lock);
+    Py_END_ALLOW_THREADS
+
+    if (state == SLOT_FREE) {
+        PyErr_SetString(PyExc_ValueError, "Reader is closed.");
+        return -1;
+    }
+    if (state != SLOT_FILLED) {
+        PyErr_SetString(PyExc_BufferError, "All read buffers are still exported, release the returned memoryviews.");
+        return -1;
+    }
+    if (slot->kind == SLOT_ERROR) {
+        PyErr_Format(PyExc_ValueError, "Failed to read from tape: %s", strerror(slot->error));
+        return -1;
+    }
+    if (slot->kind == SLOT_FILEMARK) {
+        self->filemarks_read++;
+        return SLOT_FILEMARK;
+    }
+
+    self->current = index;
+    self->offset = 0;
+    self->blocks_read++;
+    return SLOT_BLOCK;
+}
+
+static int reader_begin(TapeReaderObject *self) {
+    if (self->fd < 0) {
+        PyErr_SetString(PyExc_ValueError, "Reader is closed.");
+        return -1;
+    }
+    if (self->busy) {
+        PyErr_SetString(PyExc_ValueError, "Reader is busy.");
+        return -1;
+    }
+    if (self->pending_type != NULL) {
+        PyErr_Restore(self->pending_type, self->pending_value, self->pending_traceback);
+        self->pending_type = self->pending_value = self->pending_traceback = NULL;
+        return -1;
+    }
+    self->busy = 1;
+    return 0;
+}
+
+static int tape_reader_getbuffer(TapeReaderObject *self, Py_buffer *view, int flags) {
+    if (!self->exposing || self->current < 0) {
+        PyErr_SetString(PyExc_BufferError, "Blocks are available only through read_block().");
+        return -1;
+    }
+    ReaderSlot *slot = &self->slots[self->current];
+    if (PyBuffer_FillInfo(view, (PyObject *) self, slot->data + self->offset, slot->length - self->offset, 1, flags) < 0) {
+        return -1;
+    }
+    view->internal = (void *) (intptr_t) self->current;
+    slot->exports++;
+    return 0;
+}
+
+static void tape_reader_releasebuffer(TapeReaderObject *self, Py_buffer *view) {
+    ReaderSlot *slot = &self->slots[(intptr_t) view->internal];
+    slot->exports--;
+    if (slot->exports == 0 && slot->state == SLOT_HELD) {
+        pthread_mutex_lock(&self->lock);
+        slot->state = SLOT_FREE;
+        pthread_cond_broadcast(&self->cond);
+        pthread_mutex_unlock(&self->lock);
+    }
+}
+
+/* Returns a memoryview of the rest of the current block or of the next one,
+ * NULL without an exception set at a filemark. */
+static PyObject *reader_next_block(TapeReaderObject *self) {
+    if (reader_begin(self) < 0) {
+        return NULL;
+    }
+    if (self->pending_filemark) {
+        self->pending_filemark = 0;
+        self->busy = 0;
+        return NULL;
+    }
+
+    if (self->current < 0 || self->offset == self->slots[self->current].length) {
+        int kind = reader_take(self);
+        if (kind != SLOT_BLOCK) {
+            self->busy = 0;
+            return NULL;
+        }
+    }
+
+    ReaderSlot *slot = &self->slots[self->current];
+    self->exposing = 1;
+    PyObject *view = PyMemoryView_FromObject((PyObject *) self);
+    self->exposing = 0;
+    if (view != NULL) {
+        self->bytes_read += slot->length - self->offset;
+        self->offset = slot->length;
+    }
+    self->busy = 0;
+
+    return view;
+}
+
+static PyObject *method_read_block(TapeReaderObject *self, PyObject *Py_UNUSED(ignored)) {
+    PyObject *view = reader_next_block(self);
+    if (view == NULL && !PyErr_Occurred()) {
+        Py_RETURN_NONE;
+    }
+    return view;
+}
+
+static PyObject *method_readinto(TapeReaderObject *self, PyObject *args) {
+    Py_buffer buffer;
+    if(!PyArg_ParseTuple(args, "w*", &buffer)) {
+        return NULL;
+    }
+    if (reader_begin(self) < 0) {
+        PyBuffer_Release(&buffer);
+        return NULL;
+    }
+
+    size_t total = 0;
+    if (self->pending_filemark) {
+        self->pending_filemark = 0;
+    } else while (total < (size_t) buffer.len) {
+        if (self->current >= 0 && self->offset < self->slots[self->current].length) {
+            ReaderSlot *slot = &self->slots[self->current];
+            size_t chunk = slot->length - self->offset;
+            if (chunk > (size_t) buffer.len - total) chunk = (size_t) buffer.len - total;
+            Py_BEGIN_ALLOW_THREADS
+            memcpy((char *) buffer.buf + total, slot->data + self->offset, chunk);
+            Py_END_ALLOW_THREADS
+            self->offset += chunk;
+            self->bytes_read += chunk;
+            total += chunk;
+            continue;
+        }
+
+        int kind = reader_take(self);
+        if (kind == SLOT_FILEMARK) {
+            self->pending_filemark = total > 0;
+            break;
+        }
+        if (kind < 0) {
+            if (total == 0) {
+                self->busy = 0;
+                PyBuffer_Release(&buffer);
+                return NULL;
+            }
+            /* Report the data already copied, the error is raised by the next call */
+            PyErr_Fetch(&self->pending_type, &self->pending_value, &self->pending_traceback);
+            break;
+        }
+    }
+    self->busy = 0;
+    PyBuffer_Release(&buffer);
+
+    return PyLong_FromSize_t(total);
+}
+
+static void reader_release(TapeReaderObject *self) {
+    if (self->thread_started) {
+        Py_BEGIN_ALLOW_THREADS
+        pthread_mutex_lock(&self->lock);
+        self->closing = 1;
+        pthread_cond_broadcast(&self->cond);
+        pthread_mutex_unlock(&self->lock);
+        pthread_join(self->thread, NULL);
+        Py_END_ALLOW_THREADS
+        self->thread_started = 0;
+    }
+    if (self->device != NULL) {
+        tape_device_stream_end(self->device, self->device_blocks + self->device_filemarks, self->device_filemarks, self->device_error);
+        tape_device_release(self->device);
+        Py_CLEAR(self->device);
+    }
+    self->fd = -1;
+}
+
+static PyObject *method_reader_close(TapeReaderObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->busy) {
+        PyErr_SetString(PyExc_ValueError, "Reader is busy.");
+        return NULL;
+    }
+    reader_release(self);
+
+    Py_RETURN_NONE;
+}
+
+static int tape_reader_init(TapeReaderObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = {"device", "block_size", "buffers", NULL};
+    TapeDeviceObject *device;
+    Py_ssize_t block_size;
+    int slots_count = 2;
+    if(!PyArg_ParseTupleAndKeywords(args, kwds, "O!n|i", kwlist, &TapeDeviceType, &device, &block_size, &slots_count)) {
+        return -1;
+    }
+    if (self->slots != NULL) {
+        PyErr_SetString(PyExc_ValueError, "Reader is already open.");
+        return -1;
+    }
+    if (block_size <= 0 || slots_count < 2) {
+        PyErr_SetString(PyExc_ValueError, "Block size has to be positive and at least two buffers are required.");
+        return -1;
+    }
+
+    self->slots = calloc(slots_count, sizeof(ReaderSlot));
+    if (self->slots == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->slots_count = slots_count;
+    self->block_size = (size_t) block_size;
+    for (int i = 0; i < slots_count; i++) {
+        if (posix_memalign((void **) &self->slots[i].data, STREAM_BUFFER_ALIGNMENT, self->block_size)) {
+            self->slots[i].data = NULL;
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+
+    int fd = tape_device_acquire(device);
+    if (fd < 0) {
+        return -1;
+    }
+    Py_INCREF(device);
+    self->device = device;
+    self->fd = fd;
+    tape_device_stream_begin(device);
+
+    if (pthread_create(&self->thread, NULL, reader_thread, self)) {
+        reader_release(self);
+        PyErr_SetString(PyExc_ValueError, "Failed to start reader thread.");
+        return -1;
+    }
+    self->thread_started = 1;
+
+    return 0;
+}
+
+static PyObject *tape_reader_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    TapeReaderObject *self = (TapeReaderObject *) type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->fd = -1;
+        self->current = -1;
+        pthread_mutex_init(&self->lock, NULL);
+        pthread_cond_init(&self->cond, NULL);
+    }
+    return (PyObject *) self;
+}
+
+static void tape_reader_dealloc(TapeReaderObject *self) {
+    reader_release(self);
+    if (self->slots != NULL) {
+        for (int i = 0; i < self->slots_count; i++) free(self->slots[i].data);
+        free(self->slots);
+    }
+    Py_XDECREF(self->pending_type);
+    Py_XDECREF(self->pending_value);
+    Py_XDECREF(self->pending_traceback);
+    pthread_cond_destroy(&self->cond);
+    pthread_mutex_destroy(&self->lock);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *method_reader_enter(TapeReaderObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->fd < 0) {
+        PyErr_SetString(PyExc_ValueError, "Reader is closed.");
+        return NULL;
+    }
+
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
+static PyObject *method_reader_exit(TapeReaderObject *self, PyObject *args) {
+    return method_reader_close(self, NULL);
+}
+
+static PyObject *tape_reader_get_closed(TapeReaderObject *self, void *closure) {
+    return PyBool_FromLong(self->fd < 0);
+}
+
+static PyObject *tape_reader_get_block_size(TapeReaderObject *self, void *closure) {
+    return PyLong_FromSize_t(self->block_size);
+}
+
+static PyObject *tape_reader_get_blocks_read(TapeReaderObject *self, void *closure) {
+    return PyLong_FromUnsignedLongLong(self->blocks_read);
+}
+
+static PyObject *tape_reader_get_bytes_read(TapeReaderObject *self, void *closure) {
+    return PyLong_FromUnsignedLongLong(self->bytes_read);
+}
+
+static PyObject *tape_reader_get_filemarks_read(TapeReaderObject *self, void *closure) {
+    return PyLong_FromUnsignedLongLong(self->filemarks_read);
+}
+
+static PyMethodDef tape_reader_methods[] = {
+    {"read_block", (PyCFunction) method_read_block, METH_NOARGS, "Return a memoryview of the next block, None at a filemark"},
+    {"readinto", (PyCFunction) method_readinto, METH_VARARGS, "Read up to the next filemark into a writable buffer"},
+    {"close", (PyCFunction) method_reader_close, METH_NOARGS, "Stop the reader thread"},
+    {"__enter__", (PyCFunction) method_reader_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction) method_reader_exit, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef tape_reader_getset[] = {
+    {"closed", (getter) tape_reader_get_closed, NULL, "True if the reader is closed", NULL},
+    {"block_size", (getter) tape_reader_get_block_size, NULL, "Size of the read buffers, the largest supported block", NULL},
+    {"blocks_read", (getter) tape_reader_get_blocks_read, NULL, "Number of blocks returned to Python", NULL},
+    {"bytes_read", (getter) tape_reader_get_bytes_read, NULL, "Number of bytes returned to Python", NULL},
+    {"filemarks_read", (getter) tape_reader_get_filemarks_read, NULL, "Number of filemarks passed", NULL},
+    {NULL}
+};
+
+static PyBufferProcs tape_reader_as_buffer = {
+    .bf_getbuffer = (getbufferproc) tape_reader_getbuffer,
+    .bf_releasebuffer = (releasebufferproc) tape_reader_releasebuffer,
+};
+
+PyTypeObject TapeReaderType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.tape.TapeReader",
+    .tp_doc = "Block reader filling a ring of buffers ahead on a native thread",
+    .tp_basicsize = sizeof(TapeReaderObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = tape_reader_new,
+    .tp_init = (initproc) tape_reader_init,
+    .tp_dealloc = (destructor) tape_reader_dealloc,
+    .tp_iter = PyObject_SelfIter,
+    .tp_iternext = (iternextfunc) reader_next_block,
+    .tp_as_buffer = &tape_reader_as_buffer,
+    .tp_methods = tape_reader_methods,
+    .tp_getset = tape_reader_getset,
+};
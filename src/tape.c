@@ -8,62 +8,130 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include "tape.h"
+#include "device.h"
+#include "latency.h"
 
 
-static PyObject *method_query_partitions(PyObject *self, PyObject *args) {
-    char *path;
-    if(!PyArg_ParseTuple(args, "s", &path)) {
-        return NULL;
+int tape_device_acquire(TapeDeviceObject *self) {
+    if (self->fd < 0) {
+        PyErr_SetString(PyExc_ValueError, "Device is closed.");
+        return -1;
     }
+    self->in_use++;
+    return self->fd;
+}
 
-    int fd = open(path, O_RDWR);
-    if (fd < 0) {
-        PyErr_SetString(PyExc_ValueError, "Failed to open ioctl device.");
-        return NULL;
-    }
+void tape_device_release(TapeDeviceObject *self) {
+    self->in_use--;
+}
 
-    struct query_partition query;
+static void position_invalidate(TapeDeviceObject *self) {
+    self->position.known = 0;
+    self->position.file_known = 0;
+}
 
-    if (ioctl(fd, STIOC_QUERY_PARTITION, &query)) {
-        close(fd);
-        PyErr_SetString(PyExc_ValueError, "Failed to make a query");
-        return NULL;
+static void position_set(TapeDeviceObject *self, unsigned int partition, unsigned long long block) {
+    self->position.known = 1;
+    self->position.partition = partition;
+    self->position.block = block;
+}
+
+/* Moves over blocks, filemarks among them, a move before the start of the partition is impossible */
+static void position_advance(TapeDeviceObject *self, long long blocks, long long filemarks) {
+    TrackedPosition *position = &self->position;
+    if (!position->known || (blocks < 0 && (unsigned long long) -blocks > position->block)) {
+        position_invalidate(self);
+        return;
     }
+    position->block += blocks;
+    if (position->file_known && filemarks < 0 && (unsigned long long) -filemarks > position->file) {
+        position->file_known = 0;
+    }
+    position->file += filemarks;
+}
 
-    int err = 0;
-    PyObject *output = PyDict_New();
-    err += PyDict_SetItem(output, PyUnicode_FromString("max_partitions"), PyLong_FromLong(query.max_partitions));
-    err += PyDict_SetItem(output, PyUnicode_FromString("active_partition"), PyLong_FromLong(query.active_partition));
-    err += PyDict_SetItem(output, PyUnicode_FromString("number_of_partitions"), PyLong_FromLong(query.number_of_partitions));
-    err += PyDict_SetItem(output, PyUnicode_FromString("size_unit"), PyLong_FromLong(query.size_unit));
+void tape_device_stream_begin(TapeDeviceObject *self) {
+    self->position.streams++;
+}
+
+void tape_device_stream_end(TapeDeviceObject *self, unsigned long long blocks, unsigned long long filemarks, int error) {
+    self->position.streams--;
+    if (error) position_invalidate(self);
+    else position_advance(self, (long long) blocks, (long long) filemarks);
+}
 
-    PyObject *size_list = PyList_New(MAX_PARTITIONS);
-    for (int i=0; i < MAX_PARTITIONS;i++) {
-        PyList_SET_ITEM(size_list, i, PyLong_FromLong(query.size[i]));
+/* Outcome of a successful STIOCTOP on the tracked position */
+static void position_after_operation(TapeDeviceObject *self, short op, long count) {
+    switch (op) {
+        case STREW:
+        case STRETEN:
+            /* Rewinding goes to the beginning of partition 0 from anywhere */
+            position_set(self, 0, 0);
+            self->position.file_known = 1;
+            self->position.file = 0;
+            break;
+        case STERASE:
+            /* Erases from the current position, which does not move */
+            break;
+        case STWEOF:
+            position_advance(self, count, count);
+            break;
+        case STFSR:
+            position_advance(self, count, 0);
+            break;
+        case STRSR:
+            position_advance(self, -count, 0);
+            break;
+        case STFSF:
+        case STRSF: {
+            /* Only the file is known, the blocks of the skipped files are not */
+            int file_known = self->position.file_known;
+            unsigned long long file = self->position.file;
+            position_invalidate(self);
+            if (file_known && (op == STFSF || (unsigned long) count <= file)) {
+                self->position.file_known = 1;
+                self->position.file = op == STFSF ? file + count : file - count;
+            }
+            break;
+        }
+        case STTUR:
+            break;
+        default:
+            position_invalidate(self);
     }
-    err += PyDict_SetItem(output, PyUnicode_FromString("size"), size_list);
-    err += PyDict_SetItem(output, PyUnicode_FromString("partition_method"), PyLong_FromLong(query.partition_method));
+}
 
-    if (err > 0) {
-        close(fd);
-        PyErr_SetString(PyExc_ValueError, "Failed to return results.");
+static PyObject *method_query_partitions(TapeDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    int fd = tape_device_acquire(self);
+    if (fd < 0) {
         return NULL;
     }
-    close(fd);
 
-    return output;
+    struct query_partition query;
+
+    int ret;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOC_QUERY_PARTITION, &query);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
+        PyErr_SetString(PyExc_ValueError, "Failed to make a query");
+        return NULL;
+    }
+
+    return tape_partitions_from(&query);
 }
 
-static PyObject *method_set_active_partition(PyObject *self, PyObject *args) {
-    char *path;
+static PyObject *method_set_active_partition(TapeDeviceObject *self, PyObject *args) {
     uint8_t part;
-    if(!PyArg_ParseTuple(args, "sb", &path, &part)) {
+    if(!PyArg_ParseTuple(args, "b", &part)) {
         return NULL;
     }
 
-    int fd = open(path, O_RDWR);
+    int fd = tape_device_acquire(self);
     if (fd < 0) {
-        PyErr_SetString(PyExc_ValueError, "Failed to open ioctl device.");
         return NULL;
     }
 
@@ -71,27 +139,34 @@ static PyObject *method_set_active_partition(PyObject *self, PyObject *args) {
     query.partition_number = part;
     query.logical_block_id = 0L;
 
-    if (ioctl(fd, STIOC_SET_ACTIVE_PARTITION, &query)) {
-        close(fd);
+    int ret;
+    uint64_t start = latency_now();
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOC_SET_ACTIVE_PARTITION, &query);
+    latency_record(LATENCY_LOCATE, self->path, LATENCY_NO_ADDRESS, LATENCY_NO_ADDRESS, start);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
+        position_invalidate(self);
         PyErr_SetString(PyExc_ValueError, "Failed to set active partition");
         return NULL;
     }
-    close(fd);
+    position_set(self, part, 0);
+    self->position.file_known = 1;
+    self->position.file = 0;
 
     Py_RETURN_NONE;
 }
 
-static PyObject *method_set_tape_position(PyObject *self, PyObject *args) {
-    char *path;
+static PyObject *method_set_tape_position(TapeDeviceObject *self, PyObject *args) {
     uint8_t id_type;
     unsigned long id;
-    if(!PyArg_ParseTuple(args, "sbk", &path, &id_type, &id)) {
+    if(!PyArg_ParseTuple(args, "bk", &id_type, &id)) {
         return NULL;
     }
 
-    int fd = open(path, O_RDWR);
+    int fd = tape_device_acquire(self);
     if (fd < 0) {
-        PyErr_SetString(PyExc_ValueError, "Failed to open ioctl device.");
         return NULL;
     }
 
@@ -99,195 +174,194 @@ static PyObject *method_set_tape_position(PyObject *self, PyObject *args) {
     query.logical_id_type = id_type;
     query.logical_id = id;
 
-    if (ioctl(fd, STIOC_LOCATE_16, &query)) {
-        close(fd);
+    int ret;
+    uint64_t start = latency_now();
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOC_LOCATE_16, &query);
+    latency_record(LATENCY_LOCATE, self->path, LATENCY_NO_ADDRESS, LATENCY_NO_ADDRESS, start);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
+        position_invalidate(self);
         PyErr_SetString(PyExc_ValueError, "Failed to set tape position");
         return NULL;
     }
-    close(fd);
+    if (id_type == LOGICAL_ID_BLOCK_TYPE) {
+        /* Stays in the partition, so the block is only known if the partition is */
+        if (self->position.known) {
+            self->position.file_known = self->position.file_known && self->position.block == id;
+            self->position.block = id;
+        } else {
+            self->position.file_known = 0;
+        }
+    } else {
+        int partition_known = self->position.known;
+        position_invalidate(self);
+        self->position.file_known = partition_known && id_type == LOGICAL_ID_FILE_TYPE;
+        self->position.file = id;
+    }
 
     Py_RETURN_NONE;
 }
 
-static PyObject *method_sync_tape(PyObject *self, PyObject *args) {
-    char *path;
-    if(!PyArg_ParseTuple(args, "s", &path)) {
-        return NULL;
-    }
-
-    int fd = open(path, O_RDWR);
+static PyObject *method_sync_tape(TapeDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    int fd = tape_device_acquire(self);
     if (fd < 0) {
-        PyErr_SetString(PyExc_ValueError, "Failed to open ioctl device.");
         return NULL;
     }
 
-    if (ioctl(fd, STIOCSYNC)) {
-        close(fd);
+    int ret;
+    uint64_t start = latency_now();
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOCSYNC, NULL);
+    latency_record(LATENCY_SYNC, self->path, LATENCY_NO_ADDRESS, LATENCY_NO_ADDRESS, start);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
         PyErr_SetString(PyExc_ValueError, "Failed to sync tape");
         return NULL;
     }
-    close(fd);
 
     Py_RETURN_NONE;
 }
 
-static PyObject *method_send_tape_operation(PyObject *self, PyObject *args) {
-    char *path;
+/* Only the operations with a histogram are timed, -1 for the others */
+static int tape_operation_latency(short op) {
+    switch (op) {
+        case STREW: return LATENCY_REWIND;
+        case STINSRT: case STLOAD: return LATENCY_LOAD;
+        case STEJECT: case STOFFL: return LATENCY_UNLOAD;
+        default: return -1;
+    }
+}
+
+static PyObject *method_send_tape_operation(TapeDeviceObject *self, PyObject *args) {
     short op;
     long count;
 
-    if(!PyArg_ParseTuple(args, "shl", &path, &op, &count)) {
+    if(!PyArg_ParseTuple(args, "hl", &op, &count)) {
         return NULL;
     }
 
-    int fd = open(path, O_RDWR);
+    int fd = tape_device_acquire(self);
     if (fd < 0) {
-        PyErr_SetString(PyExc_ValueError, "Failed to open ioctl device.");
         return NULL;
     }
 
+    int operation = tape_operation_latency(op);
     struct stop query;
     query.st_op = op;
     query.st_count = count;
 
-    if (ioctl(fd, STIOCTOP, &query)) {
-        close(fd);
+    int ret;
+    uint64_t start = latency_now();
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOCTOP, &query);
+    if (operation >= 0) latency_record(operation, self->path, LATENCY_NO_ADDRESS, LATENCY_NO_ADDRESS, start);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
+        position_invalidate(self);
         PyErr_SetString(PyExc_ValueError, "Failed to send operation");
         return NULL;
     }
-    close(fd);
+    position_after_operation(self, op, count);
 
     Py_RETURN_NONE;
 }
 
-static PyObject *method_query_params(PyObject *self, PyObject *args) {
-    char *path;
-    if(!PyArg_ParseTuple(args, "s", &path)) {
+static PyObject *method_load_unload(TapeDeviceObject *self, PyObject *args) {
+    int load, immediate = 0;
+    if(!PyArg_ParseTuple(args, "p|p", &load, &immediate)) {
         return NULL;
     }
 
-    int fd = open(path, O_RDWR);
+    int fd = tape_device_acquire(self);
     if (fd < 0) {
-        PyErr_SetString(PyExc_ValueError, "Failed to open ioctl device.");
         return NULL;
     }
 
-    struct stchgp_s query;
-
-    if (ioctl(fd, STIOCQRYP, &query)) {
-        close(fd);
-        PyErr_SetString(PyExc_ValueError, "Failed to make a query");
+    struct tape_load_unload query;
+    memset(&query, 0, sizeof(query));
+    query.load = load;
+    query.immediate = immediate;
+
+    int ret;
+    uint64_t start = latency_now();
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOC_LOAD_UNLOAD, &query);
+    latency_record((load ? LATENCY_LOAD : LATENCY_UNLOAD), self->path, LATENCY_NO_ADDRESS, LATENCY_NO_ADDRESS, start);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    position_invalidate(self);
+    if (ret) {
+        PyErr_SetString(PyExc_ValueError, load ? "Failed to load tape" : "Failed to unload tape");
         return NULL;
     }
 
-    int err = 0;
-    PyObject *output = PyDict_New();
-    err += PyDict_SetItem(output, PyUnicode_FromString("autoload"), PyBool_FromLong(query.autoload));
-    err += PyDict_SetItem(output, PyUnicode_FromString("buffered_mode"), PyBool_FromLong(query.buffered_mode));
-    err += PyDict_SetItem(output, PyUnicode_FromString("compression"), PyBool_FromLong(query.compression));
-    err += PyDict_SetItem(output, PyUnicode_FromString("trailer_labels"), PyBool_FromLong(query.trailer_labels));
-    err += PyDict_SetItem(output, PyUnicode_FromString("rewind_immediate"), PyBool_FromLong(query.rewind_immediate));
-    err += PyDict_SetItem(output, PyUnicode_FromString("bus_domination"), PyBool_FromLong(query.bus_domination));
-    err += PyDict_SetItem(output, PyUnicode_FromString("logging"), PyBool_FromLong(query.logging));
-    err += PyDict_SetItem(output, PyUnicode_FromString("write_protect"), PyBool_FromLong(query.write_protect));
-    err += PyDict_SetItem(output, PyUnicode_FromString("emulate_autoloader"), PyBool_FromLong(query.emulate_autoloader));
-    err += PyDict_SetItem(output, PyUnicode_FromString("wfm_immediate"), PyBool_FromLong(query.wfm_immediate));
-    err += PyDict_SetItem(output, PyUnicode_FromString("limit_read_recov"), PyBool_FromLong(query.limit_read_recov));
-    err += PyDict_SetItem(output, PyUnicode_FromString("limit_write_recov"), PyBool_FromLong(query.limit_write_recov));
-    err += PyDict_SetItem(output, PyUnicode_FromString("data_safe_mode"), PyBool_FromLong(query.data_safe_mode));
-    err += PyDict_SetItem(output, PyUnicode_FromString("disable_sim_logging"), PyBool_FromLong(query.disable_sim_logging));
-    err += PyDict_SetItem(output, PyUnicode_FromString("read_sili_bit"), PyBool_FromLong(query.read_sili_bit));
-    err += PyDict_SetItem(output, PyUnicode_FromString("disable_auto_drive_dump"), PyBool_FromLong(query.disable_auto_drive_dump));
-    err += PyDict_SetItem(output, PyUnicode_FromString("trace"), PyBool_FromLong(query.trace));
-
-    err += PyDict_SetItem(output, PyUnicode_FromString("acf_mode"), PyLong_FromUnsignedLong(query.acf_mode));
-    err += PyDict_SetItem(output, PyUnicode_FromString("record_space_mode"), PyLong_FromUnsignedLong(query.record_space_mode));
-    err += PyDict_SetItem(output, PyUnicode_FromString("logical_write_protect"), PyLong_FromUnsignedLong(query.logical_write_protect));
-    err += PyDict_SetItem(output, PyUnicode_FromString("capacity_scaling"), PyLong_FromUnsignedLong(query.capacity_scaling));
-    err += PyDict_SetItem(output, PyUnicode_FromString("retain_reservation"), PyLong_FromUnsignedLong(query.retain_reservation));
-    err += PyDict_SetItem(output, PyUnicode_FromString("alt_pathing"), PyLong_FromUnsignedLong(query.alt_pathing));
-    err += PyDict_SetItem(output, PyUnicode_FromString("medium_type"), PyLong_FromUnsignedLong(query.medium_type));
-    err += PyDict_SetItem(output, PyUnicode_FromString("density_code"), PyLong_FromUnsignedLong(query.density_code));
-    err += PyDict_SetItem(output, PyUnicode_FromString("read_past_filemark"), PyLong_FromUnsignedLong(query.read_past_filemark));
-    err += PyDict_SetItem(output, PyUnicode_FromString("capacity_scaling_value"), PyLong_FromUnsignedLong(query.capacity_scaling_value));
-    err += PyDict_SetItem(output, PyUnicode_FromString("busy_retry"), PyLong_FromUnsignedLong(query.busy_retry));
-    err += PyDict_SetItem(output, PyUnicode_FromString("reserve_type"), PyLong_FromUnsignedLong(query.reserve_type));
-
-    err += PyDict_SetItem(output, PyUnicode_FromString("hkwrd"), PyLong_FromUnsignedLong(query.hkwrd));
-    err += PyDict_SetItem(output, PyUnicode_FromString("min_blksize"), PyLong_FromUnsignedLong(query.min_blksize));
-    err += PyDict_SetItem(output, PyUnicode_FromString("max_blksize"), PyLong_FromUnsignedLong(query.max_blksize));
-    err += PyDict_SetItem(output, PyUnicode_FromString("max_scsi_xfer"), PyLong_FromUnsignedLong(query.max_scsi_xfer));
-    err += PyDict_SetItem(output, PyUnicode_FromString("blksize"), PyLong_FromLong(query.blksize));
-    err += PyDict_SetItem(output, PyUnicode_FromString("volid"), PyUnicode_FromStringAndSize((const char*) &query.volid, 16));
+    Py_RETURN_NONE;
+}
 
-    if (err > 0) {
-        close(fd);
-        PyErr_SetString(PyExc_ValueError, "Failed to return results.");
+static PyObject *method_query_params(TapeDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    int fd = tape_device_acquire(self);
+    if (fd < 0) {
         return NULL;
     }
-    close(fd);
 
-    return output;
-}
+    struct stchgp_s query;
 
-static PyObject *method_get_tape_position(PyObject *self, PyObject *args) {
-    char *path;
-    if(!PyArg_ParseTuple(args, "s", &path)) {
+    int ret;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOCQRYP, &query);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
+        PyErr_SetString(PyExc_ValueError, "Failed to make a query");
         return NULL;
     }
 
-    int fd = open(path, O_RDWR);
+    return tape_params_from(&query);
+}
+
+static PyObject *method_get_tape_position(TapeDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    int fd = tape_device_acquire(self);
     if (fd < 0) {
-        PyErr_SetString(PyExc_ValueError, "Failed to open ioctl device.");
         return NULL;
     }
 
     struct stpos_s query;
 
-    if (ioctl(fd, STIOCQRYPOS, &query)) {
-        close(fd);
+    int ret;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOCQRYPOS, &query);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
         PyErr_SetString(PyExc_ValueError, "Failed to make a query");
         return NULL;
     }
-
-    int err = 0;
-    PyObject *output = PyDict_New();
-    err += PyDict_SetItem(output, PyUnicode_FromString("eot"), PyBool_FromLong(query.eot));
-    err += PyDict_SetItem(output, PyUnicode_FromString("bot"), PyBool_FromLong(query.bot));
-
-    err += PyDict_SetItem(output, PyUnicode_FromString("tapepos"), PyLong_FromUnsignedLong(query.tapepos));
-    err += PyDict_SetItem(output, PyUnicode_FromString("curpos"), PyLong_FromUnsignedLong(query.curpos));
-    err += PyDict_SetItem(output, PyUnicode_FromString("lbot"), PyLong_FromUnsignedLong(query.lbot));
-    err += PyDict_SetItem(output, PyUnicode_FromString("num_blocks"), PyLong_FromUnsignedLong(query.num_blocks));
-
-    err += PyDict_SetItem(output, PyUnicode_FromString("block_type"), PyLong_FromUnsignedLong(query.block_type));
-    err += PyDict_SetItem(output, PyUnicode_FromString("partition_number"), PyLong_FromUnsignedLong(query.partition_number));
-
-    if (err > 0) {
-        close(fd);
-        PyErr_SetString(PyExc_ValueError, "Failed to return results.");
-        return NULL;
+    if (self->position.streams == 0 && query.block_type == QP_LOGICAL) {
+        int same = self->position.known && self->position.partition == query.partition_number && self->position.block == query.curpos;
+        position_set(self, query.partition_number, query.curpos);
+        self->position.file_known = self->position.file_known && same;
     }
-    close(fd);
 
-    return output;
+    return tape_position_from(&query);
 }
 
-static PyObject *method_partition_tape(PyObject *self, PyObject *args) {
-    char *path;
+static PyObject *method_partition_tape(TapeDeviceObject *self, PyObject *args) {
     uint8_t partition_type;
     uint8_t partitions_count;
     uint8_t size_unit;
     uint8_t partition_method;
 
     PyObject *size_list;
-    if(!PyArg_ParseTuple(args, "sbbbbO!", &path, &partition_type, &partitions_count, &size_unit, &partition_method, &PyList_Type, &size_list)) {
+    if(!PyArg_ParseTuple(args, "bbbbO!", &partition_type, &partitions_count, &size_unit, &partition_method, &PyList_Type, &size_list)) {
         return NULL;
     }
 
-    int fd = open(path, O_RDWR);
+    int fd = tape_device_acquire(self);
     if (fd < 0) {
-        PyErr_SetString(PyExc_ValueError, "Failed to open ioctl device.");
         return NULL;
     }
 
@@ -306,32 +380,36 @@ static PyObject *method_partition_tape(PyObject *self, PyObject *args) {
         } else query.size[i] = 0;
     }
 
-    if (ioctl(fd, STIOC_CREATE_PARTITION, &query)) {
-        close(fd);
+    int ret;
+    uint64_t start = latency_now();
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOC_CREATE_PARTITION, &query);
+    latency_record(LATENCY_PARTITION, self->path, LATENCY_NO_ADDRESS, LATENCY_NO_ADDRESS, start);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    position_invalidate(self);
+    if (ret) {
         PyErr_SetString(PyExc_ValueError, "Failed to create partitions");
         return NULL;
     }
-    close(fd);
 
     Py_RETURN_NONE;
 }
 
-static PyObject *method_get_tape_ids(PyObject *self, PyObject *args) {
-    char *path;
-    if(!PyArg_ParseTuple(args, "s", &path)) {
-        return NULL;
-    }
-
-    int fd = open(path, O_RDWR);
+static PyObject *method_get_tape_ids(TapeDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    int fd = tape_device_acquire(self);
     if (fd < 0) {
-        PyErr_SetString(PyExc_ValueError, "Failed to open ioctl device.");
         return NULL;
     }
 
     struct inquiry_data query;
 
-    if (ioctl(fd, SIOC_INQUIRY, &query)) {
-        close(fd);
+    int ret;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, SIOC_INQUIRY, &query);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
         PyErr_SetString(PyExc_ValueError, "Failed to make a query");
         return NULL;
     }
@@ -343,37 +421,608 @@ static PyObject *method_get_tape_ids(PyObject *self, PyObject *args) {
     err += PyDict_SetItem(output, PyUnicode_FromString("revision"), PyUnicode_FromStringAndSize((const char*) query.revision, REV_LEN));
 
     if (err > 0) {
-        close(fd);
         PyErr_SetString(PyExc_ValueError, "Failed to return results.");
         return NULL;
     }
-    close(fd);
 
     return output;
 }
 
-static PyMethodDef tape_methods[] = {
-    {"_query_partitions", method_query_partitions, METH_VARARGS, "Query available partitions"},
-    {"_set_active_partition", method_set_active_partition, METH_VARARGS, "Set active partition"},
-    {"_set_tape_position", method_set_tape_position, METH_VARARGS, "Set tape position"},
-    {"_sync_tape", method_sync_tape, METH_VARARGS, "Sync buffers to the tape"},
-    {"_query_params", method_query_params, METH_VARARGS, "Query params"},
-    {"_get_tape_position", method_get_tape_position, METH_VARARGS, "Get tape position"},
-    {"_send_tape_operation", method_send_tape_operation, METH_VARARGS, "Send a tape operation"},
-    {"_partition_tape", method_partition_tape, METH_VARARGS, "Partition a tape"},
-    {"_get_tape_ids", method_get_tape_ids, METH_VARARGS, "Get product and vendor id of a tape"},
+/* Unit serial number page, the serial follows the 4 byte page header */
+#define INQUIRY_PAGE_SERIAL 0x80
+
+static PyObject *method_get_serial(TapeDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    int fd = tape_device_acquire(self);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct inquiry_page page;
+    memset(&page, 0, sizeof(page));
+    page.page_code = INQUIRY_PAGE_SERIAL;
+
+    int ret;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, SIOC_INQUIRY_PAGE, &page);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
+        PyErr_SetString(PyExc_ValueError, "Failed to read the serial number");
+        return NULL;
+    }
+
+    const char *serial = page.data + 4;
+    int length = (unsigned char) page.data[3];
+    if (length > MAX_INQ_LEN - 4) length = MAX_INQ_LEN - 4;
+    while (length > 0 && *serial == ' ') {
+        serial++;
+        length--;
+    }
+    while (length > 0 && (serial[length - 1] == ' ' || serial[length - 1] == '\0')) length--;
+
+    return PyUnicode_FromStringAndSize(serial, length);
+}
+
+static void put_be(unsigned char *dest, unsigned long long value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+        dest[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+unsigned long long get_be(const unsigned char *src, int bytes) {
+    unsigned long long value = 0;
+    for (int i = 0; i < bytes; i++) value = (value << 8) | src[i];
+    return value;
+}
+
+static PyObject *method_query_rao(TapeDeviceObject *self, PyObject *args) {
+    uint8_t uds_type;
+    if(!PyArg_ParseTuple(args, "b", &uds_type)) {
+        return NULL;
+    }
+
+    int fd = tape_device_acquire(self);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct query_rao_info query;
+    memset(&query, 0, sizeof(query));
+    query.uds_type = uds_type;
+
+    int ret;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOC_QUERY_RAO, &query);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
+        PyErr_SetString(PyExc_ValueError, "Failed to query RAO support");
+        return NULL;
+    }
+
+    int err = 0;
+    PyObject *output = PyDict_New();
+    err += PyDict_SetItem(output, PyUnicode_FromString("max_uds_number"), PyLong_FromUnsignedLong(query.max_uds_number));
+    err += PyDict_SetItem(output, PyUnicode_FromString("max_uds_size"), PyLong_FromUnsignedLong(query.max_uds_size));
+    err += PyDict_SetItem(output, PyUnicode_FromString("max_host_uds_number"), PyLong_FromUnsignedLong(query.max_host_uds_number));
+
+    if (err > 0) {
+        PyErr_SetString(PyExc_ValueError, "Failed to return results.");
+        return NULL;
+    }
+
+    return output;
+}
+
+static PyObject *method_generate_rao(TapeDeviceObject *self, PyObject *args) {
+    uint8_t process;
+    uint8_t uds_type;
+    PyObject *extents;
+    if(!PyArg_ParseTuple(args, "bbO!", &process, &uds_type, &PyList_Type, &extents)) {
+        return NULL;
+    }
+
+    Py_ssize_t count = PyList_Size(extents);
+    size_t length = RAO_LIST_HEADER_LEN + count * RAO_UDS_DESC_LEN;
+    unsigned char *list = calloc(1, length);
+    if (list == NULL) {
+        return PyErr_NoMemory();
+    }
+    put_be(list + 4, length - RAO_LIST_HEADER_LEN, 4);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        unsigned char partition;
+        unsigned long long begin, end;
+        if (!PyArg_ParseTuple(PyList_GetItem(extents, i), "bKK", &partition, &begin, &end)) {
+            free(list);
+            return NULL;
+        }
+        unsigned char *desc = list + RAO_LIST_HEADER_LEN + i * RAO_UDS_DESC_LEN;
+        char name[32];
+        put_be(desc, RAO_UDS_DESC_LEN - 2, 2);
+        /* The position in the request is used as UDS name to map results back */
+        snprintf(name, sizeof(name), "%-10zd", i);
+        memcpy(desc + 5, name, RAO_UDS_NAME_LEN);
+        desc[15] = partition;
+        put_be(desc + 16, begin, 8);
+        put_be(desc + 24, end, 8);
+    }
+
+    int fd = tape_device_acquire(self);
+    if (fd < 0) {
+        free(list);
+        return NULL;
+    }
+
+    struct generate_rao query;
+    memset(&query, 0, sizeof(query));
+    query.process = process;
+    query.uds_type = uds_type;
+    query.grao_list_leng = length;
+    query.grao_list = (char *) list;
+
+    int ret;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOC_GENERATE_RAO, &query);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    free(list);
+    if (ret) {
+        PyErr_SetString(PyExc_ValueError, "Failed to generate RAO list");
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *method_receive_rao(TapeDeviceObject *self, PyObject *args) {
+    unsigned int count;
+    unsigned int max_uds_size;
+    if(!PyArg_ParseTuple(args, "II", &count, &max_uds_size)) {
+        return NULL;
+    }
+    if (max_uds_size < RAO_UDS_DESC_LEN) max_uds_size = RAO_UDS_DESC_LEN;
+
+    size_t length = RAO_LIST_HEADER_LEN + (size_t) count * max_uds_size;
+    unsigned char *list = calloc(1, length);
+    if (list == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    int fd = tape_device_acquire(self);
+    if (fd < 0) {
+        free(list);
+        return NULL;
+    }
+
+    struct receive_rao_list query;
+    memset(&query, 0, sizeof(query));
+    query.rrao_list_offset = 0;
+    query.rrao_list_leng = length;
+    query.rrao_list = (char *) list;
+
+    int ret;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOC_RECEIVE_RAO, &query);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
+        free(list);
+        PyErr_SetString(PyExc_ValueError, "Failed to receive RAO list");
+        return NULL;
+    }
+
+    size_t available = query.rrao_list_leng < length ? query.rrao_list_leng : length;
+    size_t end = RAO_LIST_HEADER_LEN + get_be(list + 4, 4);
+    if (end > available) end = available;
+
+    PyObject *output = PyList_New(0);
+    if (output == NULL) {
+        free(list);
+        return NULL;
+    }
+    size_t pos = RAO_LIST_HEADER_LEN;
+    while (pos + RAO_UDS_DESC_LEN <= end) {
+        unsigned char *desc = list + pos;
+        PyObject *extent = tape_rao_descriptor_from(desc);
+        if (extent == NULL || PyList_Append(output, extent)) {
+            Py_XDECREF(extent);
+            Py_DECREF(output);
+            free(list);
+            return NULL;
+        }
+        Py_DECREF(extent);
+
+        pos += get_be(desc, 2) + 2;
+    }
+    free(list);
+
+    return output;
+}
+
+/* The drive is the authority, unless a stream is moving the tape meanwhile */
+static void position_from_long(TapeDeviceObject *self, struct long_data_format *data) {
+    if (self->position.streams > 0) {
+        return;
+    }
+    if (data->mpu || data->lonu) {
+        position_invalidate(self);
+        return;
+    }
+    position_set(self, data->active_partition, get_be(data->logical_obj_number, sizeof(data->logical_obj_number)));
+    self->position.file_known = 1;
+    self->position.file = get_be(data->logical_file_id, sizeof(data->logical_file_id));
+}
+
+static int read_position(TapeDeviceObject *self, struct read_tape_position *query, unsigned char format) {
+    int fd = tape_device_acquire(self);
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(query, 0, sizeof(*query));
+    query->data_format = format;
+
+    int ret;
+    Py_BEGIN_ALLOW_THREADS
+    ret = dev_ioctl(fd, STIOC_READ_POSITION_EX, query);
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
+        PyErr_SetString(PyExc_ValueError, "Failed to read position");
+        return -1;
+    }
+
+    if (format == RP_LONG_FORM) {
+        position_from_long(self, &query->rp_data.rp_long);
+    }
+    return 0;
+}
+
+static PyObject *method_read_position_long(TapeDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    struct read_tape_position query;
+    if (read_position(self, &query, RP_LONG_FORM)) {
+        return NULL;
+    }
+
+    return tape_long_position_from(&query.rp_data.rp_long);
+}
+
+static PyObject *method_read_position(TapeDeviceObject *self, PyObject *args) {
+    unsigned char format = RP_LONG_FORM;
+    if(!PyArg_ParseTuple(args, "|b", &format)) {
+        return NULL;
+    }
+    if (format != RP_SHORT_FORM && format != RP_LONG_FORM && format != RP_EXTENDED_FORM) {
+        PyErr_SetString(PyExc_ValueError, "Unknown position format");
+        return NULL;
+    }
+
+    struct read_tape_position query;
+    if (read_position(self, &query, format)) {
+        return NULL;
+    }
+
+    if (format == RP_SHORT_FORM) return tape_short_position_from(&query.rp_data.rp_short);
+    if (format == RP_EXTENDED_FORM) return tape_extended_position_from(&query.rp_data.rp_extended);
+    return tape_long_position_from(&query.rp_data.rp_long);
+}
+
+typedef struct {
+    uint64_t time;
+    struct long_data_format data;
+} PositionSample;
+
+/* Reads the long form count times, interval seconds apart, all without the GIL.
+ * Samples are (monotonic time in ns, partition, block, file, set). */
+static PyObject *method_sample_positions(TapeDeviceObject *self, PyObject *args) {
+    Py_ssize_t count;
+    double interval = 0;
+    if(!PyArg_ParseTuple(args, "n|d", &count, &interval)) {
+        return NULL;
+    }
+    if (count <= 0 || interval < 0) {
+        PyErr_SetString(PyExc_ValueError, "Count has to be positive and interval not negative");
+        return NULL;
+    }
+
+    PositionSample *samples = calloc(count, sizeof(PositionSample));
+    if (samples == NULL) {
+        return PyErr_NoMemory();
+    }
+    int fd = tape_device_acquire(self);
+    if (fd < 0) {
+        free(samples);
+        return NULL;
+    }
+
+    int ret = 0;
+    Py_BEGIN_ALLOW_THREADS
+    struct read_tape_position query;
+    uint64_t next = latency_now();
+    for (Py_ssize_t i = 0; i < count && !ret; i++) {
+        if (i > 0 && interval > 0) {
+            next += (uint64_t) (interval * 1e9);
+            uint64_t now = latency_now();
+            if (next > now) sim_sleep((next - now) / 1e9);
+        }
+        memset(&query, 0, sizeof(query));
+        query.data_format = RP_LONG_FORM;
+        samples[i].time = latency_now();
+        ret = dev_ioctl(fd, STIOC_READ_POSITION_EX, &query);
+        samples[i].data = query.rp_data.rp_long;
+    }
+    Py_END_ALLOW_THREADS
+    tape_device_release(self);
+    if (ret) {
+        free(samples);
+        PyErr_SetString(PyExc_ValueError, "Failed to read position");
+        return NULL;
+    }
+
+    position_from_long(self, &samples[count - 1].data);
+    PyObject *output = PyList_New(count);
+    for (Py_ssize_t i = 0; output != NULL && i < count; i++) {
+        struct long_data_format *data = &samples[i].data;
+        PyObject *sample = Py_BuildValue("(KIKKK)", (unsigned long long) samples[i].time, (unsigned int) data->active_partition,
+                                         get_be(data->logical_obj_number, sizeof(data->logical_obj_number)),
+                                         get_be(data->logical_file_id, sizeof(data->logical_file_id)),
+                                         get_be(data->obsolete, sizeof(data->obsolete)));
+        if (sample == NULL) {
+            Py_CLEAR(output);
+            break;
+        }
+        PyList_SET_ITEM(output, i, sample);
+    }
+    free(samples);
+
+    return output;
+}
+
+/* Answers from the tracked position, the drive is asked only when it is uncertain */
+static PyObject *method_get_position(TapeDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    TrackedPosition *position = &self->position;
+    if (position->known && position->file_known && position->streams == 0) {
+        return Py_BuildValue("(IKK)", position->partition, position->block, position->file);
+    }
+
+    struct read_tape_position query;
+    if (read_position(self, &query, RP_LONG_FORM)) {
+        return NULL;
+    }
+    struct long_data_format *data = &query.rp_data.rp_long;
+    return Py_BuildValue("(IKK)", (unsigned int) data->active_partition, get_be(data->logical_obj_number, sizeof(data->logical_obj_number)),
+                         get_be(data->logical_file_id, sizeof(data->logical_file_id)));
+}
+
+static PyObject *method_invalidate_position(TapeDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    position_invalidate(self);
+    Py_RETURN_NONE;
+}
+
+static int tape_device_init(TapeDeviceObject *self, PyObject *args, PyObject *kwds) {
+    char *path;
+    if(!PyArg_ParseTuple(args, "s", &path)) {
+        return -1;
+    }
+
+    if (self->fd >= 0) {
+        dev_close(self->fd);
+    }
+    free(self->path);
+    memset(&self->position, 0, sizeof(self->position));
+    self->path = strdup(path);
+    if (self->path == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    self->fd = dev_open(path, O_RDWR);
+    if (self->fd < 0) {
+        PyErr_SetString(PyExc_ValueError, "Failed to open ioctl device.");
+        return -1;
+    }
+
+    return 0;
+}
+
+static PyObject *tape_device_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    TapeDeviceObject *self = (TapeDeviceObject *) type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->fd = -1;
+    }
+    return (PyObject *) self;
+}
+
+static void tape_device_dealloc(TapeDeviceObject *self) {
+    if (self->fd >= 0) {
+        dev_close(self->fd);
+    }
+    free(self->path);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *method_close(TapeDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->in_use > 0) {
+        PyErr_SetString(PyExc_ValueError, "Device is busy.");
+        return NULL;
+    }
+    if (self->fd >= 0) {
+        dev_close(self->fd);
+        self->fd = -1;
+    }
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *method_enter(TapeDeviceObject *self, PyObject *Py_UNUSED(ignored)) {
+    if (tape_device_acquire(self) < 0) {
+        return NULL;
+    }
+    tape_device_release(self);
+
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
+static PyObject *method_exit(TapeDeviceObject *self, PyObject *args) {
+    return method_close(self, NULL);
+}
+
+static PyObject *tape_device_get_closed(TapeDeviceObject *self, void *closure) {
+    return PyBool_FromLong(self->fd < 0);
+}
+
+static PyObject *tape_device_get_position_known(TapeDeviceObject *self, void *closure) {
+    TrackedPosition *position = &self->position;
+    return PyBool_FromLong(position->known && position->file_known && position->streams == 0);
+}
+
+static PyMethodDef tape_device_methods[] = {
+    {"query_partitions", (PyCFunction) method_query_partitions, METH_NOARGS, "Query available partitions"},
+    {"set_active_partition", (PyCFunction) method_set_active_partition, METH_VARARGS, "Set active partition"},
+    {"set_tape_position", (PyCFunction) method_set_tape_position, METH_VARARGS, "Set tape position"},
+    {"sync_tape", (PyCFunction) method_sync_tape, METH_NOARGS, "Sync buffers to the tape"},
+    {"query_params", (PyCFunction) method_query_params, METH_NOARGS, "Query params"},
+    {"get_tape_position", (PyCFunction) method_get_tape_position, METH_NOARGS, "Get tape position"},
+    {"send_tape_operation", (PyCFunction) method_send_tape_operation, METH_VARARGS, "Send a tape operation"},
+    {"load_unload", (PyCFunction) method_load_unload, METH_VARARGS, "Load or unload the tape, immediate returns before the drive finishes"},
+    {"partition_tape", (PyCFunction) method_partition_tape, METH_VARARGS, "Partition a tape"},
+    {"get_tape_ids", (PyCFunction) method_get_tape_ids, METH_NOARGS, "Get product and vendor id of a tape"},
+    {"get_serial", (PyCFunction) method_get_serial, METH_NOARGS, "Get serial number of the drive"},
+    {"read_position_long", (PyCFunction) method_read_position_long, METH_NOARGS, "Read long form of the tape position"},
+    {"read_position", (PyCFunction) method_read_position, METH_VARARGS, "Read the tape position in the given format, long by default"},
+    {"sample_positions", (PyCFunction) method_sample_positions, METH_VARARGS, "Read the long position count times, interval seconds apart, as (time_ns, partition, block, file, set)"},
+    {"get_position", (PyCFunction) method_get_position, METH_NOARGS, "Return (partition, block, file), the drive is asked only if the tracked position is uncertain"},
+    {"invalidate_position", (PyCFunction) method_invalidate_position, METH_NOARGS, "Forget the tracked position, e.g. after the tape was moved by another handle"},
+    {"query_rao", (PyCFunction) method_query_rao, METH_VARARGS, "Query limits of the recommended access order"},
+    {"generate_rao", (PyCFunction) method_generate_rao, METH_VARARGS, "Ask the drive to generate the recommended access order"},
+    {"receive_rao", (PyCFunction) method_receive_rao, METH_VARARGS, "Receive the generated recommended access order"},
+    {"close", (PyCFunction) method_close, METH_NOARGS, "Close the device"},
+    {"__enter__", (PyCFunction) method_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction) method_exit, METH_VARARGS, NULL},
     {NULL, NULL, 0, NULL}
 };
 
+static PyGetSetDef tape_device_getset[] = {
+    {"closed", (getter) tape_device_get_closed, NULL, "True if the device is closed", NULL},
+    {"position_known", (getter) tape_device_get_position_known, NULL, "True if get_position answers without asking the drive", NULL},
+    {NULL}
+};
+
+PyTypeObject TapeDeviceType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tapes.internal.tape.TapeDevice",
+    .tp_doc = "Open handle of the lin_tape device",
+    .tp_basicsize = sizeof(TapeDeviceObject),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = tape_device_new,
+    .tp_init = (initproc) tape_device_init,
+    .tp_dealloc = (destructor) tape_device_dealloc,
+    .tp_methods = tape_device_methods,
+    .tp_getset = tape_device_getset,
+};
+
+
+static PyMethodDef tape_module_methods[] = {
+    {"latency_snapshot", (PyCFunction) latency_snapshot, METH_NOARGS, "Latency histograms of the tape operations"},
+    {"latency_reset", (PyCFunction) latency_reset, METH_NOARGS, "Drop all latency histograms of the tape operations"},
+    {NULL, NULL, 0, NULL}
+};
 
 static struct PyModuleDef tape_module = {
     PyModuleDef_HEAD_INIT,
     "tape",
     "Python interface for the tapes",
     -1,
-    tape_methods
+    tape_module_methods
 };
 
 PyMODINIT_FUNC PyInit_tape(void) {
-    return PyModule_Create(&tape_module);
+    if (PyType_Ready(&TapeDeviceType) < 0 || PyType_Ready(&TapeWriterType) < 0 || PyType_Ready(&TapeReaderType) < 0) {
+        return NULL;
+    }
+    if (PyType_Ready(&TapeParamsType) < 0 || PyType_Ready(&TapePositionType) < 0 || PyType_Ready(&TapePartitionsType) < 0 || PyType_Ready(&TapeLongPositionType) < 0) {
+        return NULL;
+    }
+    if (PyType_Ready(&TapeShortPositionType) < 0 || PyType_Ready(&TapeExtendedPositionType) < 0 || PyType_Ready(&TapeRaoDescriptorType) < 0) {
+        return NULL;
+    }
+
+    PyObject *module = PyModule_Create(&tape_module);
+    if (module == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(&TapeDeviceType);
+    if (PyModule_AddObject(module, "TapeDevice", (PyObject *) &TapeDeviceType) < 0) {
+        Py_DECREF(&TapeDeviceType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&TapeWriterType);
+    if (PyModule_AddObject(module, "TapeWriter", (PyObject *) &TapeWriterType) < 0) {
+        Py_DECREF(&TapeWriterType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&TapeReaderType);
+    if (PyModule_AddObject(module, "TapeReader", (PyObject *) &TapeReaderType) < 0) {
+        Py_DECREF(&TapeReaderType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&TapeParamsType);
+    if (PyModule_AddObject(module, "TapeParams", (PyObject *) &TapeParamsType) < 0) {
+        Py_DECREF(&TapeParamsType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&TapePositionType);
+    if (PyModule_AddObject(module, "TapePosition", (PyObject *) &TapePositionType) < 0) {
+        Py_DECREF(&TapePositionType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&TapePartitionsType);
+    if (PyModule_AddObject(module, "TapePartitions", (PyObject *) &TapePartitionsType) < 0) {
+        Py_DECREF(&TapePartitionsType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&TapeLongPositionType);
+    if (PyModule_AddObject(module, "TapeLongPosition", (PyObject *) &TapeLongPositionType) < 0) {
+        Py_DECREF(&TapeLongPositionType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&TapeShortPositionType);
+    if (PyModule_AddObject(module, "TapeShortPosition", (PyObject *) &TapeShortPositionType) < 0) {
+        Py_DECREF(&TapeShortPositionType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&TapeExtendedPositionType);
+    if (PyModule_AddObject(module, "TapeExtendedPosition", (PyObject *) &TapeExtendedPositionType) < 0) {
+        Py_DECREF(&TapeExtendedPositionType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(&TapeRaoDescriptorType);
+    if (PyModule_AddObject(module, "TapeRaoDescriptor", (PyObject *) &TapeRaoDescriptorType) < 0) {
+        Py_DECREF(&TapeRaoDescriptorType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    return module;
 }
@@ -0,0 +1,72 @@
+#ifndef TAPES_TAPE_H
+#define TAPES_TAPE_H
+
+#include <Python.h>
+
+
+/* Logical position as left by the operations of this handle, so it can be
+ * answered without asking the drive. The file is the number of filemarks
+ * before the position. Streams move the tape on their own threads, while one
+ * is open the position is uncertain and it is advanced when the stream ends. */
+typedef struct {
+    int known;
+    int file_known;
+    unsigned int partition;
+    unsigned long long block;
+    unsigned long long file;
+    int streams;
+} TrackedPosition;
+
+typedef struct {
+    PyObject_HEAD
+    int fd;
+    int in_use;
+    char *path;
+    TrackedPosition position;
+} TapeDeviceObject;
+
+extern PyTypeObject TapeDeviceType;
+extern PyTypeObject TapeWriterType;
+extern PyTypeObject TapeReaderType;
+extern PyTypeObject TapeParamsType;
+extern PyTypeObject TapePositionType;
+extern PyTypeObject TapePartitionsType;
+extern PyTypeObject TapeLongPositionType;
+extern PyTypeObject TapeShortPositionType;
+extern PyTypeObject TapeExtendedPositionType;
+extern PyTypeObject TapeRaoDescriptorType;
+
+/* GENERATE/RECEIVE RAO lists are passed to the drive as SCSI parameter data */
+#define RAO_LIST_HEADER_LEN 8
+#define RAO_UDS_DESC_LEN 32
+#define RAO_UDS_NAME_LEN 10
+
+struct stchgp_s;
+struct stpos_s;
+struct query_partition;
+struct long_data_format;
+struct short_data_format;
+struct extended_data_format;
+
+/* Result objects copy the struct, its fields are decoded when read */
+PyObject *tape_params_from(const struct stchgp_s *query);
+PyObject *tape_position_from(const struct stpos_s *query);
+PyObject *tape_partitions_from(const struct query_partition *query);
+PyObject *tape_long_position_from(const struct long_data_format *data);
+PyObject *tape_short_position_from(const struct short_data_format *data);
+PyObject *tape_extended_position_from(const struct extended_data_format *data);
+PyObject *tape_rao_descriptor_from(const unsigned char *desc);
+
+unsigned long long get_be(const unsigned char *src, int bytes);
+
+/* Marks the device as used by a call which may release the GIL, so the
+ * descriptor cannot be closed by another thread in the meantime. */
+int tape_device_acquire(TapeDeviceObject *self);
+void tape_device_release(TapeDeviceObject *self);
+
+/* Called with the GIL held, the stream ends with the blocks and filemarks it
+ * moved over on the device, error drops the position. */
+void tape_device_stream_begin(TapeDeviceObject *self);
+void tape_device_stream_end(TapeDeviceObject *self, unsigned long long blocks, unsigned long long filemarks, int error);
+
+#endif
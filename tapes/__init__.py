@@ -1,2 +1,3 @@
 from .tape import Tape
 from .changer import Changer
+from .aio import AsyncTape, AsyncChanger
@@ -0,0 +1,117 @@
+from concurrent.futures import ThreadPoolExecutor
+from .tape import Tape
+from .changer import Changer
+import asyncio
+import functools
+import inspect
+
+class AsyncDevice:
+    # Every call runs on the device's own worker thread, the native layer releases
+    # the GIL during the ioctls, so the event loop is never blocked by the device.
+    # This keeps one OS thread per open device: lin_tape has no asynchronous ioctl
+    # completion, so each operation in flight has to block some thread anyway, and
+    # an idle worker costs only its stack. Dozens of devices mean dozens of threads.
+    # A cancelled or timed out call which has not started yet is dropped from the
+    # queue, one which is already running is left to finish on the worker.
+    device_class = None
+    refused = () # blocking helpers without an async counterpart
+    def __init__(self, device, executor):
+        self.device = device
+        self._executor = executor
+    @classmethod
+    async def open(cls, device_path):
+        executor = ThreadPoolExecutor(max_workers=1, thread_name_prefix=device_path)
+        try:
+            device = await asyncio.get_running_loop().run_in_executor(executor, cls.device_class, device_path)
+        except BaseException:
+            executor.shutdown(wait=False)
+            raise
+        return cls(device, executor)
+    async def run(self, function, *args, timeout=None, **kwargs):
+        future = asyncio.get_running_loop().run_in_executor(self._executor, functools.partial(function, *args, **kwargs))
+        return await asyncio.wait_for(future, timeout)
+    def __getattr__(self, name):
+        attr = getattr(self.device, name)
+        if not callable(attr):
+            return attr
+        # Generators would be iterated on the event loop thread, async versions are defined below
+        if name in self.refused or inspect.isgeneratorfunction(attr):
+            raise AttributeError('%s.%s blocks the event loop and has no async version' % (type(self).__name__, name))
+        @functools.wraps(attr)
+        async def call(*args, timeout=None, **kwargs):
+            return await self.run(attr, *args, timeout=timeout, **kwargs)
+        return call
+    async def close(self):
+        try:
+            await self.run(self.device.close)
+        finally:
+            self._executor.shutdown(wait=False)
+    async def __aenter__(self):
+        return self
+    async def __aexit__(self, *exc_info):
+        await self.close()
+
+class AsyncIterator:
+    # Pulls every item of a blocking iterator on the device's worker thread
+    def __init__(self, device, iterator):
+        self._device = device
+        self.iterator = iterator
+    def __aiter__(self):
+        return self
+    async def __anext__(self):
+        done = object()
+        item = await self._device.run(next, self.iterator, done)
+        if item is done:
+            raise StopAsyncIteration
+        return item
+
+class AsyncStream(AsyncIterator):
+    # A reader or writer of the tape, blocks returned by the reader are only valid
+    # until the next read, just like those of the native reader
+    def __getattr__(self, name):
+        attr = getattr(self.iterator, name)
+        if not callable(attr):
+            return attr
+        @functools.wraps(attr)
+        async def call(*args, timeout=None, **kwargs):
+            return await self._device.run(attr, *args, timeout=timeout, **kwargs)
+        return call
+    async def __anext__(self):
+        if not hasattr(self.iterator, '__next__'):
+            raise TypeError('Only readers can be iterated')
+        return await super().__anext__()
+    async def __aenter__(self):
+        return self
+    async def __aexit__(self, *exc_info):
+        await self._device.run(self.iterator.close)
+
+class AsyncTape(AsyncDevice):
+    device_class = Tape
+    async def open_writer(self, *args, **kwargs):
+        return AsyncStream(self, await self.run(self.device.open_writer, *args, **kwargs))
+    async def open_reader(self, *args, **kwargs):
+        return AsyncStream(self, await self.run(self.device.open_reader, *args, **kwargs))
+    async def recall(self, extents, block_size=1024*1024, buffers=8):
+        # Yields (extent, blocks) like Tape.recall, blocks is an async iterator which has
+        # to be consumed before the next extent
+        recall = self.device.recall(extents, block_size, buffers)
+        try:
+            async for extent, blocks in AsyncIterator(self, recall):
+                yield extent, AsyncIterator(self, blocks)
+        finally:
+            await self.run(recall.close)
+
+class AsyncChanger(AsyncDevice):
+    device_class = Changer
+    refused = ('watch_callback',)
+    async def watch(self, interval=1.0):
+        # Yields the list of changes whenever something changed, stops when cancelled.
+        # The worker thread is free between polls, unlike with Changer.watch.
+        previous = await self.run(self.device.get_inventory)
+        while True:
+            await asyncio.sleep(interval)
+            current = await self.run(self.device.get_inventory, True)
+            changes = previous.diff(current)
+            previous = current
+            if changes:
+                yield changes
@@ -1,7 +1,11 @@
 from tapes.internal import changer
+from collections.abc import Mapping
 from dataclasses import dataclass
-from typing import List
 from enum import Enum
+from typing import Optional
+import heapq
+import threading
+import time
 
 class LibraryElementType(Enum):
     DRIVE, SLOT, IE_STATION, ROBOT = range(4)
@@ -15,36 +19,284 @@ class LibraryElement:
     barcode: str
 
 @dataclass
+class InventoryChange:
+    # None before an element appeared or after it disappeared
+    before: Optional[LibraryElement]
+    after: Optional[LibraryElement]
+    @property
+    def address(self):
+        return (self.after or self.before).address
+
+class ElementMap(Mapping):
+    # Read-only view resolving keys through an index of the inventory
+    def __init__(self, inventory, index):
+        self.inventory = inventory
+        self.index = index
+    def __getitem__(self, key):
+        return self.inventory[self.index[key]]
+    def __iter__(self):
+        return iter(self.index)
+    def __len__(self):
+        return len(self.index)
+
 class LibraryInventory:
-    robots: List[LibraryElement]
-    slots: List[LibraryElement]
-    drives: List[LibraryElement]
-    ie_stations: List[LibraryElement]
+    # Wraps packed native records, LibraryElement objects are created on first access
+    def __init__(self, packed):
+        self.packed = packed
+        self._elements = [None] * len(packed)
+        self._address_index = None
+        self._barcode_index = None
+        self._empty_slots = None
+        self._empty_slots_heap = None
+    def __len__(self):
+        return len(self.packed)
+    def __getitem__(self, index):
+        element = self._elements[index]
+        if element is None:
+            element_type, address, tape_source_address, is_full, barcode = self.packed[index]
+            element = LibraryElement(
+                element_type=LibraryElementType(element_type),
+                address=address,
+                tape_source_address=tape_source_address,
+                is_full=is_full,
+                barcode=barcode
+            )
+            self._elements[index] = element
+        return element
+    def _build_indexes(self):
+        if self._address_index is not None:
+            return
+        self._address_index = {}
+        self._barcode_index = {}
+        for index, (element_type, address, tape_source_address, is_full, barcode) in enumerate(self.packed):
+            self._address_index[address] = index
+            if barcode is not None:
+                self._barcode_index[barcode] = index
+        self._empty_slots = set(self.packed.find(LibraryElementType.SLOT.value, False))
+        # Sorted list is a valid heap, it gives the first empty slot like the inventory order
+        self._empty_slots_heap = sorted(self._empty_slots)
+    def _update_elements(self, indexes):
+        for index in indexes:
+            self._elements[index] = None
+        if self._address_index is None:
+            return
+        for index in indexes:
+            element_type, address, tape_source_address, is_full, barcode = self.packed[index]
+            if barcode is not None:
+                self._barcode_index[barcode] = index
+            if element_type != LibraryElementType.SLOT.value:
+                continue
+            if is_full:
+                self._empty_slots.discard(index)
+            elif index not in self._empty_slots:
+                self._empty_slots.add(index)
+                heapq.heappush(self._empty_slots_heap, index)
+    def apply_move(self, source_address, target_address):
+        self._update_elements(self.packed.apply_move(source_address, target_address))
+    def apply_exchange(self, source_address, first_target_address, second_target_address):
+        self._update_elements(self.packed.apply_exchange(source_address, first_target_address, second_target_address))
+    def diff(self, other):
+        # Changes from this inventory to a newer one, compared on the packed records
+        return [InventoryChange(before=None if i < 0 else self[i], after=None if j < 0 else other[j]) for i, j in self.packed.diff(other.packed)]
+    def refresh_range(self, device, first_address, count, scan=False):
+        # Re-reads count elements starting at first_address, returns the changed ones
+        self._build_indexes()
+        barcodes = {}
+        for address in range(first_address, first_address + count):
+            index = self._address_index.get(address)
+            if index is not None:
+                barcodes[index] = self.packed[index][4]
+        changed = device.refresh_range(self.packed, first_address, count, scan)
+        for index in changed:
+            barcode = barcodes.get(index)
+            if barcode is not None and self._barcode_index.get(barcode) == index:
+                del self._barcode_index[barcode]
+        self._update_elements(changed)
+        return [self[i] for i in changed]
+    def get_by_address(self, address):
+        self._build_indexes()
+        index = self._address_index.get(address)
+        return None if index is None else self[index]
+    def get_by_barcode(self, barcode):
+        self._build_indexes()
+        index = self._barcode_index.get(barcode)
+        return None if index is None else self[index]
+    def next_empty_slot(self, exclude=()):
+        self._build_indexes()
+        heap = self._empty_slots_heap
+        # Slots filled since they were pushed are dropped lazily
+        while heap and heap[0] not in self._empty_slots:
+            heapq.heappop(heap)
+        if heap and self[heap[0]].address in exclude:
+            # Slots reserved by moves in progress are skipped by a scan
+            index = min((i for i in self._empty_slots if self[i].address not in exclude), default=None)
+            return None if index is None else self[index]
+        return self[heap[0]] if heap else None
+    def find(self, element_type=None, is_full=None, barcode=None):
+        element_type = None if element_type is None else element_type.value
+        return [self[i] for i in self.packed.find(element_type, is_full, barcode)]
+    @property
+    def robots(self):
+        return self.find(LibraryElementType.ROBOT)
+    @property
+    def slots(self):
+        return self.find(LibraryElementType.SLOT)
+    @property
+    def drives(self):
+        return self.find(LibraryElementType.DRIVE)
+    @property
+    def ie_stations(self):
+        return self.find(LibraryElementType.IE_STATION)
     @property
     def all_elements(self):
-        return self.robots + self.slots + self.drives + self.ie_stations
+        return [self[i] for i in range(len(self))]
     @property
     def address_map(self):
-        return {elem.address: elem for elem in self.all_elements}
+        self._build_indexes()
+        return ElementMap(self, self._address_index)
     @property
     def barcode_map(self):
-        return {elem.barcode: elem for elem in self.all_elements if elem.barcode is not None}
+        self._build_indexes()
+        return ElementMap(self, self._barcode_index)
 
 class Changer:
-    def __init__(self, device_path):
-        self.dev = device_path
-    def get_inventory(self):
-        raw = changer._get_inventory(self.dev)
-        return LibraryInventory(
-            robots=[LibraryElement(element_type=LibraryElementType.ROBOT, **x) for x in raw['robots']],
-            slots=[LibraryElement(element_type=LibraryElementType.SLOT, **x) for x in raw['slots']],
-            drives=[LibraryElement(element_type=LibraryElementType.DRIVE, **x) for x in raw['drives']],
-            ie_stations=[LibraryElement(element_type=LibraryElementType.IE_STATION, **x) for x in raw['ie_stations']],
-        )
+    def __init__(self, device_path, inventory_ttl=60):
+        self.path = device_path
+        self.dev = changer.ChangerDevice(device_path)
+        # Cached inventory is kept up to date after our own moves, inventory_ttl
+        # bounds how long changes made by operators or other hosts can go unnoticed
+        self.inventory_ttl = inventory_ttl
+        self._inventory = None
+        self._inventory_time = 0
+        # Unknown until the first exchange is attempted
+        self.exchange_supported = None
+    def close(self):
+        self.dev.close()
+    def __enter__(self):
+        return self
+    def __exit__(self, *exc_info):
+        self.close()
+    def invalidate_inventory(self):
+        self._inventory = None
+    def get_inventory(self, refresh=False):
+        if refresh or self.inventory_expired():
+            self.set_inventory(self.dev.get_inventory())
+        return self._inventory
+    def inventory_expired(self):
+        return self._inventory is None or (self.inventory_ttl is not None and time.monotonic() - self._inventory_time > self.inventory_ttl)
+    def set_inventory(self, packed):
+        self._inventory = LibraryInventory(packed)
+        self._inventory_time = time.monotonic()
+    def watch(self, interval=1.0, stop: threading.Event = None):
+        # Polls the library and yields the list of changes whenever something changed,
+        # the cached inventory is replaced by every new snapshot
+        stop = stop or threading.Event()
+        previous = self.get_inventory()
+        while not stop.wait(interval):
+            current = self.get_inventory(refresh=True)
+            changes = previous.diff(current)
+            previous = current
+            if changes:
+                yield changes
+    def watch_callback(self, callback, interval=1.0, stop: threading.Event = None):
+        for changes in self.watch(interval, stop):
+            callback(changes)
+    def refresh_elements(self, elements, scan=False):
+        # Refreshes only the given elements in the cached inventory, one range covers all
+        # of them, scan makes the library check them physically first, e.g. after a door event
+        inv = self.get_inventory()
+        if not elements:
+            return []
+        first = min(element.address for element in elements)
+        last = max(element.address for element in elements)
+        return inv.refresh_range(self.dev, first, last - first + 1, scan)
+    def refresh_drives(self, scan=False):
+        return self.refresh_elements(self.get_inventory().drives, scan)
+    def refresh_ie_stations(self, scan=True):
+        return self.refresh_elements(self.get_inventory().ie_stations, scan)
+    def record_move(self, source_address, target_address):
+        # Applies a move done elsewhere, e.g. by a MountScheduler, to the cached inventory
+        if self._inventory is not None:
+            self._inventory.apply_move(source_address, target_address)
     def move_cartridge(self, source_address, target_address, robot_address):
-        changer._move_cartridge(self.dev, source_address, target_address, robot_address)
+        try:
+            self.dev.move_cartridge(source_address, target_address, robot_address)
+        except BaseException:
+            self.invalidate_inventory()
+            raise
+        self.record_move(source_address, target_address)
+    def exchange_cartridge(self, source_address, first_target_address, second_target_address, robot_address):
+        try:
+            self.dev.exchange_cartridge(source_address, first_target_address, second_target_address, robot_address)
+        except BaseException as e:
+            # Even a refused exchange could have left the picker holding a cartridge
+            if isinstance(e, NotImplementedError):
+                self.exchange_supported = False
+            self.invalidate_inventory()
+            raise
+        self.exchange_supported = True
+        if self._inventory is not None:
+            self._inventory.apply_exchange(source_address, first_target_address, second_target_address)
+    def swap_cartridge(self, slot, drive, robot_address):
+        # Puts the mounted cartridge back to its home slot, or to the slot of the new one
+        target = slot
+        if drive.tape_source_address:
+            home = self.get_inventory().get_by_address(drive.tape_source_address)
+            if home is not None and home.element_type == LibraryElementType.SLOT and not home.is_full:
+                target = home
+        self.exchange_cartridge(slot.address, drive.address, target.address, robot_address)
+    def position_robot(self, target_address, robot_address):
+        self.dev.position_robot(target_address, robot_address)
+    def idle_robot(self):
+        robots = self.get_inventory().robots
+        for robot in robots:
+            if not robot.is_full:
+                return robot
+        return None
+    # Parks a robot in front of the element of the next expected move, so its travel
+    # overlaps with the tape operation still running. Only a hint, False if not done.
+    def preposition(self, target_address, robot_address=None):
+        if robot_address is None:
+            robot = self.idle_robot()
+            if robot is None:
+                return False
+            robot_address = robot.address
+        try:
+            self.position_robot(target_address, robot_address)
+        except ValueError:
+            return False
+        return True
+    def preposition_for_load(self, barcode, robot_address=None):
+        # The source element of the next queued mount
+        element = self.get_inventory().get_by_barcode(barcode)
+        if element is None or element.element_type == LibraryElementType.ROBOT:
+            return False
+        return self.preposition(element.address, robot_address)
+    def preposition_for_unload(self, drive_address, robot_address=None):
+        # The drive whose job is about to finish
+        return self.preposition(drive_address, robot_address)
+    def wait_for_drive_release(self, drive_address, poll_interval=0.2, timeout=900):
+        # The drive gives the cartridge up to the robot once it has finished the unload
+        deadline = time.monotonic() + timeout
+        while True:
+            is_full, accessible = self.dev.element_access(drive_address)
+            if not is_full or accessible:
+                return is_full
+            if time.monotonic() >= deadline:
+                raise TimeoutError('Drive did not release the cartridge')
+            time.sleep(poll_interval)
+    def dismount(self, tape, drive_address, robot_address, poll_interval=0.2, timeout=900):
+        # Rewind and unthread run in the drive while the robot travels to it,
+        # the cartridge is moved out as soon as the drive releases it
+        tape.unload(immediate=True)
+        self.preposition(drive_address, robot_address)
+        if self.wait_for_drive_release(drive_address, poll_interval, timeout):
+            self.unload_cartridge(drive_address, robot_address)
     def load_cartridge(self, barcode, drive_address, robot_address):
         inv = self.get_inventory()
+        if barcode not in inv.barcode_map:
+            # The tape could have been imported since the inventory was cached
+            inv = self.get_inventory(refresh=True)
         robot = inv.address_map[robot_address]
         drive = inv.address_map[drive_address]
         slot = inv.barcode_map.get(barcode)
@@ -55,6 +307,11 @@ class Changer:
         if slot == drive:
             return
         if drive.is_full:
+            if self.exchange_supported is not False and slot.element_type == LibraryElementType.SLOT:
+                try:
+                    return self.swap_cartridge(slot, drive, robot.address)
+                except NotImplementedError:
+                    pass # the library does not support exchange, two moves are used
             self.unload_cartridge(drive_address, robot_address)
         self.move_cartridge(slot.address, drive.address, robot.address)
     def unload_cartridge(self, drive_address, robot_address):
@@ -66,7 +323,67 @@ class Changer:
             source_slot = inv.address_map[drive.tape_source_address]
             if not source_slot.is_full:
                 return self.move_cartridge(drive.address, source_slot.address, robot_address)
-        empty_slots = [x for x in inv.slots if not x.is_full]
-        if len(empty_slots) == 0:
+        empty_slot = inv.next_empty_slot()
+        if empty_slot is None:
             raise Exception('No slot is empty')
-        return self.move_cartridge(drive.address, empty_slots[0].address, robot_address)
+        return self.move_cartridge(drive.address, empty_slot.address, robot_address)
+
+class LibrarySet:
+    # Several logical libraries behind one barcode index. Inventories of all of them are
+    # read concurrently by native threads, a library which fails keeps its old inventory
+    # and the error is available in errors until the next successful refresh.
+    def __init__(self, device_paths, inventory_ttl=60):
+        self.changers = []
+        try:
+            for device_path in device_paths:
+                self.changers.append(Changer(device_path, inventory_ttl))
+        except BaseException:
+            self.close()
+            raise
+        self.errors = {}
+        self._barcode_index = None
+        self._index_time = 0
+    def close(self):
+        for changer_device in self.changers:
+            changer_device.close()
+    def __enter__(self):
+        return self
+    def __exit__(self, *exc_info):
+        self.close()
+    def refresh(self, force=False):
+        stale = [c for c in self.changers if force or c.inventory_expired()]
+        if not stale:
+            return
+        for changer_device, packed in zip(stale, changer.inventory_all([c.dev for c in stale])):
+            if isinstance(packed, Exception):
+                self.errors[changer_device.path] = packed
+                continue
+            self.errors.pop(changer_device.path, None)
+            changer_device.set_inventory(packed)
+        self._barcode_index = None
+    def _build_barcode_index(self):
+        self._barcode_index = {}
+        self._index_time = time.monotonic()
+        for changer_device in self.changers:
+            inv = changer_device._inventory
+            if inv is not None:
+                for barcode in inv.barcode_map:
+                    self._barcode_index.setdefault(barcode, changer_device)
+    def locate(self, barcode):
+        # Returns (changer, element) holding the barcode or None
+        self.refresh()
+        if self._barcode_index is None:
+            self._build_barcode_index()
+        changer_device = self._barcode_index.get(barcode)
+        element = None if changer_device is None else changer_device.get_inventory().get_by_barcode(barcode)
+        if element is None and any(c._inventory_time > self._index_time for c in self.changers):
+            # Inventories were re-read by the changers themselves since the index was built
+            self._build_barcode_index()
+            changer_device = self._barcode_index.get(barcode)
+            element = None if changer_device is None else changer_device.get_inventory().get_by_barcode(barcode)
+        return None if element is None else (changer_device, element)
+    def get_changer(self, device_path):
+        for changer_device in self.changers:
+            if changer_device.path == device_path:
+                return changer_device
+        raise KeyError(device_path)
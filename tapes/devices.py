@@ -0,0 +1,90 @@
+from .tape import Tape
+import glob
+import json
+import os
+import re
+
+# Rewinding device nodes only, /dev/IBMtape0n is the no-rewind twin of /dev/IBMtape0
+DEFAULT_DEVICE_PATTERN = re.compile(r'IBMtape\d+$')
+
+def list_tape_devices():
+    return sorted(path for path in glob.glob('/dev/IBMtape*') if DEFAULT_DEVICE_PATTERN.search(path))
+
+class DriveMap:
+    # Maps drive element addresses of a changer to tape device paths by serial number.
+    # Device ids of the drives are read from the changer on every refresh, the tape
+    # devices are opened to read their serials only when the drives of the library
+    # differ from the ones the map was built for, the map can be kept in a JSON file.
+    def __init__(self, changer_device, device_paths=None, cache_path=None):
+        self.changer = changer_device
+        self.device_paths = device_paths
+        self.cache_path = cache_path
+        self.drives = None
+        self.paths = {}
+        self._tapes = {}
+        if cache_path is not None and os.path.exists(cache_path):
+            self._load(cache_path)
+        self.refresh()
+    def _load(self, path):
+        try:
+            with open(path) as f:
+                data = json.load(f)
+            self.drives = [tuple(drive) for drive in data['drives']]
+            self.paths = {int(address): device for address, device in data['paths'].items()}
+        except (ValueError, KeyError, TypeError):
+            self.drives = None
+            self.paths = {}
+    def _save(self, path):
+        data = {'drives': self.drives, 'paths': {str(address): device for address, device in self.paths.items()}}
+        temporary = path + '.tmp'
+        with open(temporary, 'w') as f:
+            json.dump(data, f)
+        os.replace(temporary, path)
+    def refresh(self):
+        # Returns True if the map had to be rebuilt
+        drives = [(address, identifier) for address, is_full, identifier in self.changer.dev.read_element_devids()]
+        if drives == self.drives:
+            return False
+        self.close()
+        self.drives = drives
+        self.paths = self.discover(drives)
+        if self.cache_path is not None:
+            self._save(self.cache_path)
+        return True
+    def discover(self, drives):
+        paths = {}
+        device_paths = self.device_paths if self.device_paths is not None else list_tape_devices()
+        for device_path in device_paths:
+            try:
+                with Tape(device_path) as tape_device:
+                    serial = tape_device.get_serial()
+            except ValueError:
+                continue # busy or not a lin_tape device
+            if not serial:
+                continue
+            for address, identifier in drives:
+                # The identifier carries vendor and product ids before the serial
+                if identifier.endswith(serial) and address not in paths:
+                    paths[address] = device_path
+                    break
+        return paths
+    def get_path(self, drive_address):
+        return self.paths.get(drive_address)
+    def get_tape(self, drive_address):
+        # Handles are opened on first use and kept until the map is rebuilt or closed
+        tape_device = self._tapes.get(drive_address)
+        if tape_device is None:
+            device_path = self.paths.get(drive_address)
+            if device_path is None:
+                raise KeyError(drive_address)
+            tape_device = Tape(device_path)
+            self._tapes[drive_address] = tape_device
+        return tape_device
+    def close(self):
+        tapes, self._tapes = self._tapes, {}
+        for tape_device in tapes.values():
+            tape_device.close()
+    def __enter__(self):
+        return self
+    def __exit__(self, *exc_info):
+        self.close()
@@ -0,0 +1,70 @@
+from tapes.internal import changer, tape
+from dataclasses import dataclass, replace
+from typing import Optional, Tuple
+
+@dataclass
+class LatencyHistogram:
+    operation: str
+    device: str
+    robot: Optional[int]
+    element: Optional[int]
+    count: int
+    total: float # seconds
+    max: float # seconds
+    buckets: Tuple[int, ...] # bucket i counts operations shorter than 2**i microseconds
+    @property
+    def mean(self):
+        return self.total / self.count if self.count else 0.0
+    def bounds(self):
+        # Upper bounds of the buckets in seconds, the last bucket is unbounded
+        return [2 ** i / 10**6 for i in range(len(self.buckets) - 1)] + [float('inf')]
+
+def snapshot():
+    # Histograms recorded natively by both extensions, changer operations first
+    output = []
+    for module in (changer, tape):
+        for operation, device, robot, element, count, total_ns, max_ns, buckets in module.latency_snapshot():
+            output.append(LatencyHistogram(operation, device, robot, element, count, total_ns / 10**9, max_ns / 10**9, buckets))
+    return output
+
+def reset():
+    changer.latency_reset()
+    tape.latency_reset()
+
+def _escape(value):
+    return str(value).replace('\\', '\\\\').replace('"', '\\"').replace('\n', '\\n')
+
+def without_elements(histograms):
+    # Merges the histograms of all elements of the same operation, device and robot
+    merged = {}
+    for histogram in histograms:
+        key = (histogram.operation, histogram.device, histogram.robot)
+        other = merged.get(key)
+        if other is None:
+            merged[key] = replace(histogram, element=None)
+            continue
+        merged[key] = replace(other, count=other.count + histogram.count, total=other.total + histogram.total,
+                              max=max(other.max, histogram.max), buckets=tuple(map(sum, zip(other.buckets, histogram.buckets))))
+    return list(merged.values())
+
+def to_prometheus(histograms=None, name='tapes_operation_duration_seconds', elements=False):
+    # Every histogram has the full set of buckets, element addresses are labels only when
+    # elements is set, as there can be thousands of them in a library
+    histograms = snapshot() if histograms is None else histograms
+    if not elements:
+        histograms = without_elements(histograms)
+    lines = ['# HELP %s Duration of tape and changer operations.' % name, '# TYPE %s histogram' % name]
+    for histogram in histograms:
+        labels = 'operation="%s",device="%s"' % (_escape(histogram.operation), _escape(histogram.device))
+        if histogram.robot is not None:
+            labels += ',robot="%d"' % histogram.robot
+        if histogram.element is not None:
+            labels += ',element="%d"' % histogram.element
+        cumulative = 0
+        for bound, count in zip(histogram.bounds(), histogram.buckets):
+            cumulative += count
+            le = '+Inf' if bound == float('inf') else repr(bound)
+            lines.append('%s_bucket{%s,le="%s"} %d' % (name, labels, le, cumulative))
+        lines.append('%s_sum{%s} %r' % (name, labels, histogram.total))
+        lines.append('%s_count{%s} %d' % (name, labels, histogram.count))
+    return '\n'.join(lines) + '\n'
@@ -0,0 +1,259 @@
+from tapes.internal import changer
+from collections import Counter, OrderedDict
+from concurrent.futures import Future
+from contextlib import contextmanager
+from .changer import LibraryElementType
+import errno
+import threading
+
+def _copy_future(source, target):
+    if source.cancelled():
+        target.cancel()
+    elif source.exception() is not None:
+        target.set_exception(source.exception())
+    else:
+        target.set_result(source.result())
+
+class MountScheduler:
+    # Runs moves of the library on all robots in parallel. Moves are queued natively,
+    # each robot takes the queued move whose source is nearest to it, results come back
+    # as futures resolved by a collector thread, callbacks run on that thread.
+    # The changer device stays busy, so it cannot be closed, until the scheduler is.
+    def __init__(self, changer_device, robots=None):
+        self.changer = changer_device
+        if robots is None:
+            robots = [robot.address for robot in changer_device.get_inventory().robots]
+        self.native = changer.MoveScheduler(changer_device.dev, robots)
+        self._lock = threading.RLock()
+        self._futures = {}
+        # Elements used by mounts and dismounts in progress
+        self._reserved = set()
+        self._collector = threading.Thread(target=self._collect, name='%s-mounts' % changer_device.path, daemon=True)
+        self._collector.start()
+    def _collect(self):
+        while True:
+            results = self.native.wait()
+            if results is None:
+                break
+            finished = []
+            with self._lock:
+                for move_id, source_address, target_address, robot_address, error in results:
+                    future = self._futures.pop(move_id)
+                    if error == 0:
+                        self.changer.record_move(source_address, target_address)
+                    elif error != errno.ECANCELED:
+                        self.changer.invalidate_inventory()
+                    finished.append((future, robot_address, error))
+            for future, robot_address, error in finished:
+                if error == 0:
+                    future.set_result(robot_address)
+                elif error == errno.ECANCELED:
+                    future.cancel()
+                else:
+                    future.set_exception(ValueError('Failed to move cartridge'))
+    @property
+    def pending(self):
+        return self.native.pending
+    def move(self, source_address, target_address, robot_address=None):
+        # The future gives the address of the robot which made the move
+        future = Future()
+        with self._lock:
+            move_id = self.native.submit(source_address, target_address, robot_address)
+            self._futures[move_id] = future
+        return future
+    def _reserve(self, *addresses):
+        for address in addresses:
+            if address in self._reserved:
+                raise ValueError('Element is used by another mount')
+        self._reserved.update(addresses)
+        def release(future):
+            with self._lock:
+                self._reserved.difference_update(addresses)
+        return release
+    def dismount(self, drive_address, robot_address=None):
+        with self._lock:
+            inv = self.changer.get_inventory()
+            drive = inv.address_map[drive_address]
+            if not drive.is_full:
+                future = Future()
+                future.set_result(None)
+                return future
+            target = None
+            if drive.tape_source_address:
+                home = inv.get_by_address(drive.tape_source_address)
+                if home is not None and home.element_type == LibraryElementType.SLOT and not home.is_full and home.address not in self._reserved:
+                    target = home
+            if target is None:
+                target = inv.next_empty_slot(exclude=self._reserved)
+            if target is None:
+                raise Exception('No slot is empty')
+            release = self._reserve(drive.address, target.address)
+            try:
+                future = self.move(drive.address, target.address, robot_address)
+            except BaseException:
+                release(None)
+                raise
+        future.add_done_callback(release)
+        return future
+    def mount(self, barcode, drive_address, robot_address=None):
+        with self._lock:
+            inv = self.changer.get_inventory()
+            drive = inv.address_map[drive_address]
+            source = inv.get_by_barcode(barcode)
+            if source is None:
+                raise Exception('Given tape is not available')
+            if source.element_type == LibraryElementType.ROBOT:
+                raise Exception('Given tape is in a robot')
+            result = Future()
+            if source == drive:
+                result.set_result(None)
+                return result
+            release_source = self._reserve(source.address)
+            try:
+                if drive.is_full:
+                    first = self.dismount(drive_address, robot_address)
+                else:
+                    first = None
+                    release = self._reserve(drive.address)
+                    try:
+                        future = self.move(source.address, drive.address, robot_address)
+                    except BaseException:
+                        release(None)
+                        raise
+            except BaseException:
+                release_source(None)
+                raise
+        result.add_done_callback(release_source)
+        if first is None:
+            future.add_done_callback(release)
+            future.add_done_callback(lambda moved: _copy_future(moved, result))
+            return result
+        # The drive is reserved by the dismount, the source is moved once it is done
+        def then(dismounted):
+            if dismounted.cancelled() or dismounted.exception() is not None:
+                return _copy_future(dismounted, result)
+            try:
+                with self._lock:
+                    release = self._reserve(drive.address)
+                    try:
+                        future = self.move(source.address, drive.address, robot_address)
+                    except BaseException:
+                        release(None)
+                        raise
+            except BaseException as e:
+                return result.set_exception(e)
+            future.add_done_callback(release)
+            future.add_done_callback(lambda moved: _copy_future(moved, result))
+        first.add_done_callback(then)
+        return result
+    def close(self):
+        # Queued moves are cancelled, the ones in progress are waited for
+        self.native.close()
+        self._collector.join()
+    def __enter__(self):
+        return self
+    def __exit__(self, *exc_info):
+        self.close()
+
+class MountManager:
+    # Treats the drives as a cache of cartridges. A barcode already mounted is served
+    # by its drive, otherwise an empty drive is used and only when there is none the
+    # drive chosen by the policy is unloaded: 'lru' evicts the least recently used
+    # cartridge, 'lfu' the least often requested one. Drives in use are never evicted.
+    # Request counts of 'lfu' are halved every decay_interval requests, so they age.
+    def __init__(self, changer_device, drives=None, robot_address=None, policy='lru', decay_interval=1000):
+        if policy not in ('lru', 'lfu'):
+            raise ValueError('Unknown eviction policy')
+        self.changer = changer_device
+        inv = changer_device.get_inventory()
+        if drives is None:
+            drives = [drive.address for drive in inv.drives]
+        if robot_address is None:
+            robot_address = inv.robots[0].address
+        self.robot_address = robot_address
+        self.policy = policy
+        self.decay_interval = decay_interval
+        self._lock = threading.Lock()
+        self._loaded = threading.Condition(self._lock)
+        # One load at a time, they share the robot and the inventory cache of the changer
+        self._moves = threading.Lock()
+        # Least recently used drives first
+        self._recent = OrderedDict((address, None) for address in drives)
+        self._in_use = Counter()
+        self._requests = Counter()
+        self._until_decay = decay_interval
+        # Barcodes being loaded by drive, the drives are reserved in _in_use meanwhile
+        self._loading = {}
+    def _count_request(self, barcode):
+        self._requests[barcode] += 1
+        self._until_decay -= 1
+        if self._until_decay <= 0:
+            # Cartridges which are no longer requested drop out of the counter
+            self._requests = Counter({key: count // 2 for key, count in self._requests.items() if count > 1})
+            self._until_decay = self.decay_interval
+    def _mounted_drive(self, inv, barcode):
+        element = inv.get_by_barcode(barcode)
+        if element is not None and element.element_type == LibraryElementType.DRIVE and element.address in self._recent:
+            return element.address
+        return None
+    def _victim(self, inv):
+        free = [address for address in self._recent if not self._in_use[address]]
+        if not free:
+            raise Exception('All drives are in use')
+        for address in free:
+            if not inv.address_map[address].is_full:
+                return address
+        if self.policy == 'lfu':
+            # min keeps the least recently used among equally requested cartridges
+            return min(free, key=lambda address: self._requests[inv.address_map[address].barcode])
+        return free[0]
+    def acquire(self, barcode):
+        # Returns the address of the drive with the cartridge, which stays there until released.
+        # The cartridge is loaded outside the lock, mounted cartridges are served meanwhile.
+        with self._lock:
+            self._count_request(barcode)
+            while True:
+                inv = self.changer.get_inventory()
+                drive_address = self._mounted_drive(inv, barcode)
+                # Waits while the cartridge is loaded into, or unloaded from, another drive
+                if barcode not in self._loading.values() and drive_address not in self._loading:
+                    break
+                self._loaded.wait()
+            if drive_address is not None:
+                self._in_use[drive_address] += 1
+                self._recent.move_to_end(drive_address)
+                return drive_address
+            drive_address = self._victim(inv)
+            self._in_use[drive_address] += 1
+            self._loading[drive_address] = barcode
+        try:
+            with self._moves:
+                self.changer.load_cartridge(barcode, drive_address, self.robot_address)
+        except BaseException:
+            with self._lock:
+                del self._loading[drive_address]
+                self._release(drive_address)
+                self._loaded.notify_all()
+            raise
+        with self._lock:
+            del self._loading[drive_address]
+            self._recent.move_to_end(drive_address)
+            self._loaded.notify_all()
+        return drive_address
+    def _release(self, drive_address):
+        self._in_use[drive_address] -= 1
+        if self._in_use[drive_address] <= 0:
+            del self._in_use[drive_address]
+    def release(self, drive_address):
+        with self._lock:
+            self._release(drive_address)
+    @contextmanager
+    def mounted(self, barcode):
+        drive_address = self.acquire(barcode)
+        try:
+            yield drive_address
+        finally:
+            self.release(drive_address)
+    def mounted_barcodes(self):
+        inv = self.changer.get_inventory()
+        return {address: inv.address_map[address].barcode for address in self._recent if inv.address_map[address].is_full}
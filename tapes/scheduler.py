@@ -0,0 +1,81 @@
+from bisect import bisect_left
+from dataclasses import dataclass, replace
+from typing import List
+
+@dataclass
+class LocateTimeModel:
+    # Seconds to travel the whole length of the tape and to switch between wraps
+    end_to_end_time: float = 100.0
+    wrap_change_time: float = 2.0
+
+@dataclass
+class PhysicalPosition:
+    wrap: int
+    lpos: float # 0.0 at the beginning of the tape, 1.0 at its end
+
+# Orders extents on a serpentine tape when the drive does not support RAO. Blocks are
+# assumed to be written back to back, block_size bytes each, so the wrap and the
+# longitudinal position are estimated from the block number and the partition layout.
+class AccessScheduler:
+    def __init__(self, media, partition_wraps: List[int], block_size: int, model: LocateTimeModel = None):
+        self.media = media
+        self.block_size = block_size
+        self.model = model or LocateTimeModel()
+        self.first_wraps = []
+        first_wrap = 0
+        for wraps in partition_wraps:
+            self.first_wraps.append(first_wrap)
+            first_wrap += wraps + 2 # two wraps are left as a gap between partitions
+    def estimate_position(self, partition, block):
+        offset = block * self.block_size
+        wrap_in_partition = int(offset // self.media.wrap_size)
+        along = (offset % self.media.wrap_size) / self.media.wrap_size
+        first_wrap = self.first_wraps[partition] if partition < len(self.first_wraps) else 0
+        wrap = min(first_wrap + wrap_in_partition, self.media.wraps - 1)
+        # Even wraps are written from the beginning of the tape, odd wraps back towards it
+        return PhysicalPosition(wrap=wrap, lpos=along if wrap % 2 == 0 else 1.0 - along)
+    def locate_time(self, source: PhysicalPosition, target: PhysicalPosition):
+        time = abs(source.lpos - target.lpos) * self.model.end_to_end_time
+        if source.wrap != target.wrap:
+            time += self.model.wrap_change_time
+        return time
+    def with_locate_times(self, extents, partition, block):
+        # Fills locate_time of extents which will be read in the given order
+        position = self.estimate_position(partition, block)
+        output = []
+        for extent in extents:
+            start = self.estimate_position(extent.partition, extent.start_block)
+            output.append(replace(extent, locate_time=self.locate_time(position, start)))
+            position = self.estimate_position(extent.partition, extent.end_block + 1)
+        return output
+    def order(self, extents, partition, block):
+        # Greedy shortest locate time first, starting from the current position. Extents are
+        # bucketed by wrap and sorted by lpos, so only the two neighbours of the current lpos
+        # in every wrap can be the nearest one.
+        buckets = {}
+        for index, extent in enumerate(extents):
+            start = self.estimate_position(extent.partition, extent.start_block)
+            buckets.setdefault(start.wrap, []).append((start.lpos, index, start, extent))
+        for wrap, items in buckets.items():
+            items.sort()
+            buckets[wrap] = ([x[0] for x in items], items)
+        position = self.estimate_position(partition, block)
+        output = []
+        while buckets:
+            best = None
+            for wrap, (keys, items) in buckets.items():
+                index = bisect_left(keys, position.lpos)
+                for candidate in (index - 1, index):
+                    if 0 <= candidate < len(keys):
+                        time = self.locate_time(position, items[candidate][2])
+                        if best is None or (time, items[candidate][1]) < best[:2]:
+                            best = (time, items[candidate][1], wrap, candidate)
+            time, _, wrap, candidate = best
+            keys, items = buckets[wrap]
+            del keys[candidate]
+            _, _, start, extent = items.pop(candidate)
+            if not items:
+                del buckets[wrap]
+            output.append(replace(extent, locate_time=time))
+            position = self.estimate_position(extent.partition, extent.end_block + 1)
+        return output
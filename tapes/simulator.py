@@ -0,0 +1,37 @@
+import os
+
+# Paths with these prefixes are opened by the native layer as file backed simulators
+TAPE_PREFIX = 'sim:tape:'
+CHANGER_PREFIX = 'sim:changer:'
+
+TAPE_SETTINGS = ('serial', 'volume', 'density_code', 'medium_type', 'wraps', 'capacity', 'locate_time',
+                 'locate_block_time', 'partition_time', 'load_time', 'unload_time', 'bandwidth')
+
+def create_tape(directory, **settings):
+    # Settings are the keys of the config file, times are in seconds, bandwidth in bytes per second
+    for key in settings:
+        if key not in TAPE_SETTINGS:
+            raise ValueError('Unknown tape setting')
+    os.makedirs(directory, exist_ok=True)
+    with open(os.path.join(directory, 'config'), 'w') as f:
+        for key, value in settings.items():
+            f.write('%s %s\n' % (key, value))
+    return TAPE_PREFIX + directory
+
+def create_library(path, slots, drives=(), robots=1, ie_stations=0, barcodes=(), move_time=0.0, move_element_time=0.0):
+    # Robots get addresses from 1, drives from 256, slots from 4096 and I/E stations from 768.
+    # drives is a list of drive serials, barcodes are placed into the first slots.
+    if len(barcodes) > slots:
+        raise ValueError('More barcodes than slots')
+    lines = ['move_time %s' % move_time, 'move_element_time %s' % move_element_time]
+    lines += ['robot %d' % (1 + i) for i in range(robots)]
+    lines += ['drive %d serial=%s' % (256 + i, serial) for i, serial in enumerate(drives)]
+    lines += ['ie %d' % (768 + i) for i in range(ie_stations)]
+    for i in range(slots):
+        line = 'slot %d' % (4096 + i)
+        if i < len(barcodes):
+            line += ' barcode=%s' % barcodes[i]
+        lines.append(line)
+    with open(path, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+    return CHANGER_PREFIX + path
@@ -1,7 +1,9 @@
 from tapes.internal import tape
+from tapes.scheduler import AccessScheduler
 from dataclasses import dataclass
-from typing import List
+from typing import List, NamedTuple, Optional
 from enum import Enum
+import itertools
 import math
 
 class TapePartitionType(Enum):
@@ -13,6 +15,21 @@ class TapePartitionMethod(Enum):
 class TapeLogicalPosition(Enum):
     BLOCK, FILE = range(2)
 
+class RaoUdsType(Enum):
+    WITHOUT_GEOMETRY, WITH_GEOMETRY = range(2)
+
+class TapePositionFormat(Enum):
+    SHORT = 0x00
+    LONG = 0x06
+    EXTENDED = 0x08
+
+class TapePositionSample(NamedTuple):
+    time_ns: int # time.monotonic_ns() clock
+    partition: int
+    block: int
+    file: int
+    set: int # 0 if the drive does not report logical sets
+
 @dataclass
 class TapePartitionLayout:
     max_partitions: int
@@ -20,6 +37,13 @@ class TapePartitionLayout:
     partition_method: TapePartitionMethod
     partitions: List[int]
 
+@dataclass
+class TapeExtent:
+    partition: int
+    start_block: int
+    end_block: int # inclusive
+    locate_time: Optional[float] = None # seconds estimated by the host, None when unknown
+
 @dataclass
 class TapeTypeProperties:
     wraps: int
@@ -31,39 +55,128 @@ class TapeTypeProperties:
 
 class Tape:
     def __init__(self, device_path):
-        self.dev = device_path
+        self.path = device_path
+        self.dev = tape.TapeDevice(device_path)
+    def close(self):
+        self.dev.close()
+    def __enter__(self):
+        return self
+    def __exit__(self, *exc_info):
+        self.close()
+    def open_writer(self, block_size=512*1024, buffers=4):
+        # Blocks are written by a native thread, so Python only packs data into the ring
+        return tape.TapeWriter(self.dev, block_size, buffers)
+    def open_reader(self, block_size=1024*1024, buffers=8):
+        # block_size has to fit the largest block on the tape, reading stops at each filemark
+        return tape.TapeReader(self.dev, block_size, buffers)
+    def get_access_scheduler(self, block_size=None, model=None):
+        media = self.get_tape_type_properties()
+        if media is None:
+            return None
+        block_size = block_size or self.dev.query_params().blksize or 512*1024
+        return AccessScheduler(media, self.get_partition_layout().partitions, block_size, model)
+    def get_recommended_access_order(self, extents, use_drive=True, block_size=None):
+        extents = [x if isinstance(x, TapeExtent) else TapeExtent(*x) for x in extents]
+        # locate_time is always a host estimate of the AccessScheduler, the drive's RAO list
+        # gives only the order
+        if use_drive:
+            limits = self.get_rao_limits()
+            if limits is not None:
+                ordered = self.get_drive_access_order(extents, limits)
+                try:
+                    scheduler = self.get_access_scheduler(block_size)
+                    if scheduler is None:
+                        return ordered
+                    return scheduler.with_locate_times(ordered, *self.dev.get_position()[:2])
+                except (AssertionError, ValueError):
+                    return ordered # the estimates are optional, the drive's order stands
+        scheduler = self.get_access_scheduler(block_size)
+        if scheduler is None:
+            return extents
+        return scheduler.order(extents, *self.dev.get_position()[:2])
+    def get_rao_limits(self):
+        # None when the drive does not support RAO, a failing query or zero limits mean no support
+        try:
+            limits = self.dev.query_rao(RaoUdsType.WITHOUT_GEOMETRY.value)
+        except ValueError:
+            return None
+        if limits['max_uds_number'] == 0 or limits['max_uds_size'] == 0:
+            return None
+        return limits
+    def get_drive_access_order(self, extents, limits=None):
+        limits = limits or self.dev.query_rao(RaoUdsType.WITHOUT_GEOMETRY.value)
+        batch_size = min(x for x in (limits['max_uds_number'], limits['max_host_uds_number'], len(extents)) if x > 0)
+        ordered = []
+        for offset in range(0, len(extents), batch_size):
+            batch = extents[offset:offset + batch_size]
+            self.dev.generate_rao(
+                2, # reorder extents and calculate locate time
+                RaoUdsType.WITHOUT_GEOMETRY.value,
+                [(x.partition, x.start_block, x.end_block) for x in batch]
+            )
+            indexes = [x.index for x in self.dev.receive_rao(len(batch), limits['max_uds_size'])]
+            # Extents missing in the drive's answer are read last, in the requested order
+            received = set(indexes)
+            indexes += [i for i in range(len(batch)) if i not in received]
+            ordered += [batch[i] for i in indexes]
+        return ordered
+    def recall(self, extents, block_size=1024*1024, buffers=8):
+        # Yields (extent, blocks) in the recommended order, blocks have to be consumed before the next extent
+        partition = self.get_partition()
+        for extent in self.get_recommended_access_order(extents):
+            if extent.partition != partition:
+                self.set_partition(extent.partition)
+                partition = extent.partition
+            self.set_position_block(extent.start_block)
+            with self.open_reader(block_size, buffers) as reader:
+                yield extent, itertools.islice(reader, extent.end_block - extent.start_block + 1)
     def sync(self):
-        tape._sync_tape(self.dev)
+        self.dev.sync_tape()
+    def get_position(self):
+        # (partition, block, file) tracked by the handle, the drive is asked only when it is uncertain
+        return self.dev.get_position()
+    def read_position(self, position_format=TapePositionFormat.LONG):
+        return self.dev.read_position(position_format.value)
+    def sample_positions(self, count, interval=0.0):
+        # All samples are taken natively, interval seconds apart, e.g. while a writer is appending
+        return [TapePositionSample(*sample) for sample in self.dev.sample_positions(count, interval)]
+    def get_physical_position(self, block_size=None):
+        # Wrap and longitudinal position estimated from the block, None for unknown media
+        scheduler = self.get_access_scheduler(block_size)
+        if scheduler is None:
+            return None
+        return scheduler.estimate_position(*self.get_position()[:2])
     def get_position_block(self):
-        return tape._get_tape_position(self.dev)["curpos"]
+        return self.dev.get_position()[1]
+    def get_position_file(self):
+        return self.dev.get_position()[2]
     def set_position_block(self, block_id):
-        tape._set_tape_position(self.dev, TapeLogicalPosition.BLOCK.value, block_id)
+        self.dev.set_tape_position(TapeLogicalPosition.BLOCK.value, block_id)
     def set_position_file(self, file_id):
-        tape._set_tape_position(self.dev, TapeLogicalPosition.FILE.value, file_id)
+        self.dev.set_tape_position(TapeLogicalPosition.FILE.value, file_id)
     def set_position_to_eod(self):
-        tape._send_tape_operation(self.dev, 32, 0)
+        self.dev.send_tape_operation(32, 0)
     def set_partition(self, part_id):
-        tape._set_active_partition(self.dev, part_id)
+        self.dev.set_active_partition(part_id)
     def get_partition(self):
-        return tape._query_partitions(self.dev)['active_partition']
+        return self.dev.get_position()[0]
     def get_partition_layout(self):
         media = self.get_tape_type_properties()
-        raw = tape._query_partitions(self.dev)
-        raw_sizes = raw['size'][:raw['number_of_partitions']]
-        scaled_sizes = [round((x * 10**raw['size_unit'])/media.wrap_size) for x in raw_sizes]
+        raw = self.dev.query_partitions()
+        raw_sizes = raw.size[:raw.number_of_partitions]
+        scaled_sizes = [round((x * 10**raw.size_unit)/media.wrap_size) for x in raw_sizes]
         wraps_as_gap = 2 * (len(raw_sizes) - 1)
         used_wraps = media.wraps - wraps_as_gap
         assert sum(scaled_sizes) == used_wraps
         return TapePartitionLayout(
-            max_partitions=raw['max_partitions'],
-            active_partition=raw['active_partition'],
-            partition_method=TapePartitionMethod(raw['partition_method']),
+            max_partitions=raw.max_partitions,
+            active_partition=raw.active_partition,
+            partition_method=TapePartitionMethod(raw.partition_method),
             partitions=scaled_sizes
         )
     def create_one_partition_layout(self):
         # Most arguments are ignored if number of partitions is equal to one
-        tape._partition_tape(
-            self.dev,
+        self.dev.partition_tape(
             TapePartitionType.UNKNOWN.value, # ignored
             1, # number of partitions
             0, # size_unit, ignored
@@ -71,8 +184,7 @@ class Tape:
             [0] # partition sizes, ignored
         )
     def create_wrap_wise_fdp_partition_layout(self):
-        tape._partition_tape(
-            self.dev,
+        self.dev.partition_tape(
             TapePartitionType.FDP.value,
             2, # number of partitions, ignored, but has to be > 1
             0, # size_unit, ignored for FDP
@@ -81,8 +193,7 @@ class Tape:
         )
     def create_wrap_wise_sdp_partition_layout(self, number_of_partitions: int):
         # size_unit and size arguments are ignored
-        tape._partition_tape(
-            self.dev,
+        self.dev.partition_tape(
             TapePartitionType.SDP.value,
             number_of_partitions,
             0, # size_unit, ifnored for SDP
@@ -99,8 +210,7 @@ class Tape:
         for size_unit in range(0, 12):
             if min_part / (10**size_unit) >= 1 and max_part / (10**size_unit) < 2**16 - 1:
                 scaled_sizes = [math.floor(x / (10**size_unit)) for x in part_sizes]
-                tape._partition_tape(
-                    self.dev,
+                self.dev.partition_tape(
                     TapePartitionType.IDP.value,
                     len(scaled_sizes), # number of partitions
                     size_unit,
@@ -123,18 +233,25 @@ class Tape:
             (0x60, 0x98): TapeTypeProperties(name='LTO-9', wraps=280, size=18*10**12),
             (0x60, 0x9c): TapeTypeProperties(name='LTO-9 WORM', wraps=280, size=18*10**12)
         }
-        params = tape._query_params(self.dev)
-        return known_media.get((params['density_code'], params['medium_type']))
+        params = self.dev.query_params()
+        return known_media.get((params.density_code, params.medium_type))
     def rewind(self):
-        tape._send_tape_operation(self.dev, 6, 0)
+        self.dev.send_tape_operation(6, 0)
     def erase(self):
-        tape._send_tape_operation(self.dev, 7, 0)
+        self.dev.send_tape_operation(7, 0)
     def retension(self):
-        tape._send_tape_operation(self.dev, 8, 0)
+        self.dev.send_tape_operation(8, 0)
     def write_end_of_file_record(self):
-        tape._send_tape_operation(self.dev, 10, 0)
-    def load(self):
-        tape._send_tape_operation(self.dev, 15, 0)
-    def unload(self):
-        tape._send_tape_operation(self.dev, 16, 0)
+        self.dev.send_tape_operation(10, 0)
+    def load(self, immediate=False):
+        if immediate:
+            return self.dev.load_unload(True, True)
+        self.dev.send_tape_operation(15, 0)
+    def unload(self, immediate=False):
+        # Immediate unload returns before the drive has rewound and unthreaded the tape
+        if immediate:
+            return self.dev.load_unload(False, True)
+        self.dev.send_tape_operation(16, 0)
 
+    def get_serial(self):
+        return self.dev.get_serial()
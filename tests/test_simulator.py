@@ -0,0 +1,164 @@
+import os
+import sys
+import tempfile
+import threading
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from tapes import Tape, Changer
+from tapes.changer import LibraryInventory
+from tapes.mounts import MountManager
+from tapes.simulator import create_tape, create_library
+
+# Behaviour of the bindings against the file backed simulators, run after
+# python setup.py build_ext --inplace with python -m unittest discover tests
+
+class SimulatedTapeTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory(prefix='tapes-test-')
+        self.tape = Tape(create_tape(os.path.join(self.directory.name, 'tape')))
+    def tearDown(self):
+        self.tape.close()
+        self.directory.cleanup()
+    def write_file(self, blocks, block_size=4096):
+        with self.tape.open_writer(block_size) as writer:
+            for i in range(blocks):
+                writer.write(bytes([i % 256]) * block_size)
+        self.tape.dev.send_tape_operation(10, 1) # filemark
+
+    def test_write_read_round_trip(self):
+        self.write_file(5)
+        self.tape.rewind()
+        with self.tape.open_reader(4096) as reader:
+            blocks = [bytes(block) for block in reader]
+        self.assertEqual(blocks, [bytes([i]) * 4096 for i in range(5)])
+
+    def test_position_round_trip(self):
+        self.write_file(10)
+        self.write_file(3)
+        for block in (0, 7, 11, 14):
+            self.tape.set_position_block(block)
+            drive = self.tape.read_position()
+            self.assertEqual(self.tape.get_position()[:2], (drive.active_partition, drive.logical_obj_number))
+            self.assertEqual(self.tape.get_position_block(), block)
+        self.tape.set_position_file(1)
+        self.assertEqual(self.tape.get_position(), (0, 11, 1))
+
+    def test_position_unknown_after_partitioning(self):
+        self.tape.create_wrap_wise_sdp_partition_layout(2)
+        self.tape.set_partition(1)
+        self.tape.create_wrap_wise_sdp_partition_layout(2)
+        # A block locate does not tell the partition
+        self.tape.set_position_block(0)
+        self.assertFalse(self.tape.dev.position_known)
+        drive = self.tape.read_position()
+        self.assertEqual(self.tape.get_position(), (drive.active_partition, drive.logical_obj_number, drive.logical_file_id))
+        self.assertTrue(self.tape.dev.position_known)
+
+    def test_rewind_from_second_partition(self):
+        self.tape.create_wrap_wise_sdp_partition_layout(2)
+        self.tape.set_partition(1)
+        self.write_file(3)
+        self.tape.rewind()
+        drive = self.tape.read_position()
+        self.assertEqual((drive.active_partition, drive.logical_obj_number), (0, 0))
+        self.assertEqual(self.tape.get_position(), (0, 0, 0))
+        self.assertEqual(self.tape.get_partition(), 0)
+
+    def test_erase_keeps_position(self):
+        self.write_file(5)
+        self.tape.set_position_block(3)
+        self.tape.erase()
+        self.assertEqual(self.tape.get_position()[:2], (0, 3))
+        self.assertEqual(self.tape.read_position().logical_obj_number, 3)
+        self.tape.set_position_to_eod()
+        self.assertEqual(self.tape.get_position_block(), 3)
+
+    def test_load_starts_at_partition_zero(self):
+        self.tape.create_wrap_wise_sdp_partition_layout(2)
+        self.tape.set_partition(1)
+        self.write_file(2)
+        self.tape.unload()
+        self.tape.load()
+        self.assertEqual(self.tape.get_partition(), 0)
+        self.assertEqual(self.tape.get_position()[:2], (0, 0))
+
+    def test_read_error_is_repeated(self):
+        self.write_file(2)
+        self.tape.rewind()
+        with self.tape.open_reader(1024) as reader:
+            # Blocks larger than the buffers of the reader cannot be read
+            with self.assertRaises(ValueError):
+                reader.read_block()
+            with self.assertRaises(ValueError):
+                reader.read_block()
+
+class SimulatedChangerTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory(prefix='tapes-test-')
+        path = create_library(os.path.join(self.directory.name, 'library'), 4, ['SIM0001'], barcodes=['A00001L9', 'A00002L9'])
+        self.changer = Changer(path)
+        inv = self.changer.get_inventory()
+        self.drive = inv.drives[0].address
+        self.robot = inv.robots[0].address
+    def tearDown(self):
+        self.changer.close()
+        self.directory.cleanup()
+
+    def test_load_and_swap(self):
+        self.changer.load_cartridge('A00001L9', self.drive, self.robot)
+        self.changer.load_cartridge('A00002L9', self.drive, self.robot)
+        inv = self.changer.get_inventory(refresh=True)
+        self.assertEqual(inv.address_map[self.drive].barcode, 'A00002L9')
+        self.assertEqual(inv.get_by_barcode('A00001L9').address, 4096)
+
+    def test_exchange_failure(self):
+        inv = self.changer.get_inventory()
+        # The source is its own first destination, which the library rejects
+        with self.assertRaises(ValueError):
+            self.changer.exchange_cartridge(4096, 4096, 4097, self.robot)
+        self.assertIsNot(self.changer.exchange_supported, False)
+        self.assertIsNot(self.changer.get_inventory(), inv)
+
+class MountManagerTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory(prefix='tapes-test-')
+        # Both drives are full with cartridges without a home slot, so evictions look
+        # for empty slots in the cached inventory
+        self.path = os.path.join(self.directory.name, 'library')
+        with open(self.path, 'w') as f:
+            f.write('move_time 0.05\nrobot 1\n')
+            f.write('drive 256 serial=SIM0001 barcode=M00000L9\ndrive 257 serial=SIM0002 barcode=M00001L9\n')
+            f.write('slot 4096 barcode=M00002L9\nslot 4097 barcode=M00003L9\nslot 4098\nslot 4099\n')
+        self.changer = Changer('sim:changer:' + self.path)
+        self.changer.exchange_supported = False
+    def tearDown(self):
+        self.changer.close()
+        self.directory.cleanup()
+
+    def test_concurrent_evictions(self):
+        manager = MountManager(self.changer)
+        drives, errors = {}, []
+        def acquire(barcode):
+            try:
+                drives[barcode] = manager.acquire(barcode)
+            except Exception as e:
+                errors.append(e)
+        threads = [threading.Thread(target=acquire, args=(barcode,)) for barcode in ('M00002L9', 'M00003L9')]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(errors, [])
+        self.assertEqual(sorted(drives.values()), [256, 257])
+        with Changer('sim:changer:' + self.path) as other:
+            inv = LibraryInventory(other.dev.get_inventory())
+        for barcode, drive in drives.items():
+            self.assertEqual(inv.address_map[drive].barcode, barcode)
+        for barcode in ('M00000L9', 'M00001L9'):
+            self.assertIn(inv.get_by_barcode(barcode), inv.slots)
+        self.assertEqual(self.changer.get_inventory().diff(inv), [])
+
+if __name__ == '__main__':
+    unittest.main()